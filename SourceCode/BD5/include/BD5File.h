@@ -14,6 +14,7 @@
 #include <string>
 #include <memory>
 #include <map>
+#include <set>
 #include <limits>
 #include "H5Cpp.h"
 #include "ScaleUnit.h"
@@ -21,6 +22,9 @@
 #include "Group.h"
 #include "Object.h"
 #include "Snapshot.h"
+#include "Labels.h"
+#include "Lineage.h"
+#include "Tracks.h"
 #include "Logger.h"
 
 namespace BD5{
@@ -36,37 +40,8 @@ struct Settings {
     std::string TRACK_INFO = "/data/trackInfo";
     std::string LOG_FILE  = "bd5Viewer.log";
     bool BD5FILE_INFO_FLAG = true;
-};
-
-/**
- * @brief   The minimum and maximum coordinates of the geometry
- * 
- */
-struct Boundaries {
-    float maxX = std::numeric_limits<float>::min();
-    float maxY = std::numeric_limits<float>::min();
-    float maxZ = std::numeric_limits<float>::min();
-    float minX = std::numeric_limits<float>::max();
-    float minY = std::numeric_limits<float>::max();
-    float minZ = std::numeric_limits<float>::max();
-    void updateBoundaries(const Boundaries&);
-};
-
-/**
- * @brief   Description of a point in a track
- * 
- */
-struct PointTrack {
-    float x = 0.0;
-    float y = 0.0;
-    float z = 0.0;
-    int id = 0;
-    std::string objID = "";
-    std::string label = "";
-    void print(void) {
-        std::cout << " id " << id << " objID " << objID << " label " << label 
-            << " x " << x << " " << x*0.105 << " y " << y << " " << y*0.105 << " z " << z << " " << z*0.5 << std::endl;        
-    }
+    // Store Point, Circle and Sphere coordinates as 16-bit integers
+    bool QUANTIZED_STORAGE = false;
 };
 
 /**
@@ -148,39 +123,150 @@ public:
      */
     bool HasTracks() const;
     /**
-     * @brief   Get the a list of tracks described as PointTrack
+     * @brief   Get the a list of tracks described as PointTrack. Empty until SetTracks
      * 
      * @return std::vector<std::vector<PointTrack>> 
      */
     std::vector<std::vector<PointTrack>> GetTracks() const;
+    /**
+     * @brief   Build the tracks of the snapshots returned by Read. The BD5File is not modified,
+     *          so it can run in a background thread while the snapshots are displayed.
+     *          Read must not be called until it finishes
+     * 
+     * @param snapshots     Snapshots returned by Read
+     * @return std::vector<std::vector<PointTrack>>     The tracks described as PointTrack
+     */
+    std::vector<std::vector<PointTrack>> CreateTracks(const std::vector<BD5::Snapshot>& snapshots) const;
+    /**
+     * @brief   Store the tracks built by CreateTracks. It also sets the times of the lineage nodes
+     * 
+     * @param tracks    The tracks described as PointTrack
+     */
+    void SetTracks(const std::vector<std::vector<PointTrack>>& tracks);
+    /**
+     * @brief   Get the lineage graph described by the track info
+     * 
+     * @return const LineageGraph&  The lineage graph
+     */
+    const LineageGraph& GetLineage() const;
 
     /**
      * @brief   Get the labels corresponding to the time t
      * 
      */
     std::vector<std::vector<std::string>> GetLabelsAtTime(int);
+    /**
+     * @brief   Get the labels present at the time t as one LabelSet per object.
+     *          The ids refer to the file-wide LabelDictionary
+     * 
+     * @return const std::vector<LabelSet>&     LabelSet for every object
+     */
+    const std::vector<LabelSet>& GetLabelSetsAtTime(int);
+    /**
+     * @brief   Get the dictionary of all labels in the file
+     * 
+     * @return const LabelDictionary&   The labels dictionary
+     */
+    const LabelDictionary& GetLabelDictionary() const;
+    /**
+     * @brief   Enable or disable the quantized storage of Point, Circle and Sphere coordinates
+     *          and radii (16-bit integers relative to the box of every object and time).
+     *          It is applied on the next Read.
+     * 
+     * @param flag  Enable the quantized storage
+     */
+    void SetQuantizedStorage(bool flag);
+    /**
+     * @brief   Maximum absolute error of the coordinates and radii read with quantized storage
+     * 
+     * @return float    Maximum absolute error in file units, 0 if quantized storage was not used
+     */
+    float QuantizationError() const;
+    /**
+     * @brief   Show or hide an object. Hidden objects are not decoded by Read. The visibility
+     *          is kept by object name, so it also applies to the next files read
+     * 
+     * @param name  Object name
+     * @param flag  Visibility of the object
+     */
+    void SetObjectVisibility(const std::string& name, bool flag);
+    /**
+     * @brief   Indicates if an object is decoded by Read
+     * 
+     * @param name  Object name
+     * @return true 
+     * @return false 
+     */
+    bool IsObjectVisible(const std::string& name) const;
+    /**
+     * @brief   Decode an object for every snapshot. Used to materialise an object that was
+     *          hidden or released. Labels are updated, tracks must be created again
+     * 
+     * @param objIndex  Index of the object
+     * @param snapshots Snapshots returned by Read, updated in place
+     */
+    void ReadObject(int objIndex, std::vector<BD5::Snapshot>& snapshots);
+    /**
+     * @brief   Release the geometry of an object for every snapshot. The labels are kept
+     * 
+     * @param objIndex  Index of the object
+     * @param snapshots Snapshots returned by Read, updated in place
+     */
+    void ReleaseObject(int objIndex, std::vector<BD5::Snapshot>& snapshots);
+    /**
+     * @brief   Write an information message in the log of the file. Nothing is written
+     *          when the information messages are disabled (BD5FILE_INFO_FLAG)
+     * 
+     * @param entry     Message
+     */
+    void LogInfo(const std::string& entry) const;
 
 private:
+    // Last decoded instance of an object. While the object does not change
+    // in time its geometry block is shared instead of decoded again
+    struct DecodedObject {
+        size_t hash = 0;
+        std::vector<char> buffer;
+        BD5::Object object;
+        LabelSet labels;
+        Boundaries box;
+    };
     void Open(const std::string& f);
     BD5::ScaleUnit GetScaleUnit(BD5::DataSet&);
     std::vector<std::string> GetObjNames(BD5::DataSet&);
     std::vector<std::pair<std::string, std::string>> GetRawTrackInfo(BD5::DataSet&);
     std::vector<std::vector<std::string>> MakeTrackPaths(const std::vector<std::pair<std::string, std::string>>&);
-    std::vector<PointTrack> WriteTrackInfo(int, const std::vector<std::vector<EntityData>>&);
+    std::vector<PointTrack> WriteTrackInfo(int, const std::vector<std::vector<EntityData>>&, const std::vector<PolylineData>&) const;
+    std::vector<PointTrack> WriteTrackInfo(int, const BD5::QuantizedEntities&) const;
     std::vector<std::vector<PointTrack>> WriteTracksGeometry(const std::vector<std::vector<std::string>>&,
-                                        const std::vector<PointTrack>&);
-    std::vector<std::vector<PointTrack>> CreateTracks(const std::vector<BD5::Snapshot>&, const std::vector<std::vector<std::string>>&);
+                                        const std::vector<PointTrack>&) const;
+    BD5::Object ReadObjectDataset(const std::string&, const std::string&, float&, LabelSet&);
     TypeDescriptor GetTypeDescriptor(const H5::CompType&);
     ElementType GetElementType(const H5::CompType&, int);
     std::vector<std::vector<PointTrack>> tracks;
+    std::vector<std::vector<std::string>> trackLines;
+    LineageGraph lineage;
+    std::vector<std::string> timeGroups;
+    std::map<std::string, DecodedObject> lastDecoded;
+    int sharedObjects = 0;
+    // Names of the objects that are not decoded
+    std::set<std::string> hiddenObjects;
     BD5::ScaleUnit scales;
     std::vector<std::string> objNames;
-    // Labels are ordered as: time_index, obj_index, label_index
-    std::vector<std::vector<std::vector<std::string>>> labels;
+    // Labels are ordered as: time_index, obj_index, (bitset of label ids)
+    std::vector<std::vector<LabelSet>> labels;
+    LabelDictionary labelDictionary;
     H5::H5File file;
     BD5::Boundaries boundaries;
+    float quantizationError = 0.0;
+    // IDs of the quantized entities, a new dictionary for every file read. Snapshots of a
+    // previous file keep theirs
+    std::shared_ptr<IDDictionary> idDictionary = std::make_shared<IDDictionary>();
+    size_t quantizedEntities = 0;
+    size_t quantizedBytes = 0;
     Settings settings;
-    Logger logger;    
+    // Thread safe, it is also used by the const functions
+    mutable Logger logger;    
 };
 
 }
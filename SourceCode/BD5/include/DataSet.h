@@ -126,6 +126,14 @@ public:
      * @return std::string The string extracted from dataset
      */
     std::string ExtractStringAt(const std::string& name, int index); 
+    /**
+     * @brief   Copy of the dataset buffer with the bytes of the excluded members set to zero.
+     *          Datasets with equal masked buffers contain the same data except for those members
+     * 
+     * @param excluded  Names of the members to be masked (members not in the dataset are ignored)
+     * @return std::vector<char>    The masked buffer
+     */
+    std::vector<char> MaskedBuffer(const std::vector<std::string>& excluded) const;
 
     // For debugging.
     void ShowBuffer() const;
@@ -0,0 +1,97 @@
+/**
+ * @file    Labels.h
+ * @author  Riken. Center for Biosystems Dynamics Research. Laboratory for Developmental Dynamics
+ * @brief   LabelDictionary and LabelSet classes. The dictionary assigns a dense integer id to every
+ *          label found in a BD5 file. A LabelSet is a compact bitset of label ids describing the labels
+ *          present in an object at a specific time.
+ * @version 0.1
+ * @date    2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+
+namespace BD5 {
+
+/**
+ * @brief   File-wide dictionary of labels. Ids are assigned in order of first appearance
+ *
+ */
+class LabelDictionary
+{
+public:
+    /**
+     * @brief   Get the id of a label, registering the label if it is new
+     *
+     * @param label Label name
+     * @return int  Label id
+     */
+    int Intern(const std::string& label);
+    /**
+     * @brief   Get the id of a label without registering it
+     *
+     * @param label Label name
+     * @return int  Label id or -1 if the label is not in the dictionary
+     */
+    int Find(const std::string& label) const;
+    /**
+     * @brief   Get the name of a label
+     *
+     * @param id    Label id
+     * @throw   std::out_of_range when the id is not in the dictionary
+     * @return const std::string&   Label name
+     */
+    const std::string& Name(int id) const;
+    /**
+     * @brief   Number of labels in the dictionary
+     *
+     * @return int  Number of labels
+     */
+    int Size() const;
+    void Clear();
+private:
+    std::vector<std::string> names;
+    std::unordered_map<std::string, int> ids;
+};
+
+/**
+ * @brief   File-wide dictionary of entity IDs. An ID kept along the times is stored once
+ *
+ */
+using IDDictionary = LabelDictionary;
+
+/**
+ * @brief   Compact set of label ids stored as a bitset
+ *
+ */
+class LabelSet
+{
+public:
+    void Insert(int id);
+    bool Contains(int id) const;
+    /**
+     * @brief   Number of labels in the set
+     *
+     * @return int  Number of labels
+     */
+    int Count() const;
+    /**
+     * @brief   The label ids in the set in ascending order
+     *
+     * @return std::vector<int> Label ids
+     */
+    std::vector<int> Ids() const;
+    bool operator==(const LabelSet&) const;
+    bool operator!=(const LabelSet&) const;
+private:
+    std::vector<std::uint64_t> words;
+};
+
+}
@@ -0,0 +1,166 @@
+/**
+ * @file    Lineage.h
+ * @author  Riken. Center for Biosystems Dynamics Research. Laboratory for Developmental Dynamics
+ * @brief   LineageGraph class. Graph of the links (from, to) described in the trackInfo dataset
+ *          of a BD5 file. Nodes are the object IDs, divisions and merges are nodes with several
+ *          children or parents. The graph is indexed as a tree (the first parent of every node)
+ *          with Euler tour intervals for ancestor and subtree queries.
+ * @version 0.1
+ * @date    2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <unordered_map>
+
+namespace BD5 {
+
+/**
+ * @brief   Node of the lineage graph. Parents and children are node indices
+ *
+ */
+struct LineageNode {
+    std::string ID;
+    std::vector<int> parents;
+    std::vector<int> children;
+    bool IsRoot() const { return parents.empty(); }
+    bool IsLeaf() const { return children.empty(); }
+    bool IsDivision() const { return children.size() > 1; }
+    bool IsMerge() const { return parents.size() > 1; }
+};
+
+/**
+ * @brief   Lineage graph built in one pass from the trackInfo links
+ *
+ */
+class LineageGraph
+{
+public:
+    /**
+     * @brief   Construct an empty LineageGraph object
+     *
+     */
+    LineageGraph() {};
+    /**
+     * @brief   Construct a new LineageGraph object
+     *
+     * @param links     List of (from, to) IDs. Repeated links are ignored
+     */
+    explicit LineageGraph(const std::vector<std::pair<std::string, std::string>>& links);
+    /**
+     * @brief   Number of nodes
+     *
+     * @return int  Number of nodes
+     */
+    int Size() const;
+    /**
+     * @brief   Number of links
+     *
+     * @return int  Number of links
+     */
+    int NumLinks() const;
+    /**
+     * @brief   Get the index of the node with an ID
+     *
+     * @param ID    Object ID
+     * @return int  Node index or -1 if the ID is not in the graph
+     */
+    int Find(const std::string& ID) const;
+    /**
+     * @brief   Get a node
+     *
+     * @param index Node index
+     * @throw   std::out_of_range when the index is not in the graph
+     * @return const LineageNode&   The node
+     */
+    const LineageNode& Node(int index) const;
+    /**
+     * @brief   Split the graph in paths without branches. A path starts at a root, division,
+     *          merge or leaf node and follows the nodes with one parent and one child. Every
+     *          link belongs to one path. Paths are ordered by the position of their first link
+     *
+     * @return std::vector<std::vector<std::string>>   IDs of every path
+     */
+    std::vector<std::vector<std::string>> Paths() const;
+    /**
+     * @brief   Test if a node is an ancestor of other node in O(1). A node is ancestor of itself
+     * 
+     * @param ancestor      Node index of the ancestor
+     * @param descendant    Node index of the descendant
+     * @return true 
+     * @return false 
+     */
+    bool IsAncestor(int ancestor, int descendant) const;
+    /**
+     * @brief   Chain of ancestors of a node back to its root. Merges follow the first parent
+     * 
+     * @param index Node index
+     * @return std::vector<int> Node indices from the parent to the root
+     */
+    std::vector<int> Ancestors(int index) const;
+    /**
+     * @brief   Descendants of a node in depth-first order, O(number of descendants)
+     * 
+     * @param index Node index
+     * @return std::vector<int> Node indices of the subtree without the node itself
+     */
+    std::vector<int> Descendants(int index) const;
+    /**
+     * @brief   Number of links from the root to the node
+     * 
+     * @param index Node index
+     * @return int  Depth of the node
+     */
+    int Depth(int index) const;
+    /**
+     * @brief   Number of divisions between the root and the node
+     * 
+     * @param index Node index
+     * @return int  Generation of the node
+     */
+    int Generation(int index) const;
+    /**
+     * @brief   Division nodes in depth-first order
+     * 
+     * @return const std::vector<int>&  Node indices of the divisions
+     */
+    const std::vector<int>& Divisions() const;
+    /**
+     * @brief   Set the time index where a node appears
+     * 
+     * @param index Node index
+     * @param t     Time index
+     */
+    void SetTime(int index, int t);
+    /**
+     * @brief   Time index where a node appears. For a division it is the time of the division
+     * 
+     * @param index Node index
+     * @return int  Time index or -1 when it is not known
+     */
+    int Time(int index) const;
+private:
+    int Intern(const std::string& ID);
+    bool IsChainNode(int index) const;
+    void BuildIndex();
+    std::vector<LineageNode> nodes;
+    std::unordered_map<std::string, int> ids;
+    // Links as node indices in the order of the trackInfo dataset
+    std::vector<std::pair<int, int>> links;
+    // Euler tour of the tree: subtree of a node is preorder[tourIn, tourOut)
+    std::vector<int> preorder;
+    std::vector<int> tourIn;
+    std::vector<int> tourOut;
+    std::vector<int> depth;
+    std::vector<int> generation;
+    std::vector<int> divisions;
+    std::vector<int> times;
+};
+
+}
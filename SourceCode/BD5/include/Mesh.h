@@ -0,0 +1,241 @@
+/**
+ * @file    Mesh.h
+ * @author  Riken. Center for Biosystems Dynamics Research. Laboratory for Developmental Dynamics
+ * @brief   MeshRange struct, SnapshotMesh and Frustum classes. A SnapshotMesh is the geometry of a snapshot
+ *          flattened once into vertex and index buffers ready to be uploaded to the GPU: scaled
+ *          positions, face normals, the label id of every vertex, the sphere instances and the range of every subobject.
+ *          Subobjects are split in batches with bounding boxes to draw only the ones inside a Frustum.
+ * @version 0.1
+ * @date    2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+#include <cstdint>
+#include "Object.h"
+#include "Snapshot.h"
+#include "ScaleUnit.h"
+#include "Labels.h"
+
+namespace BD5 {
+
+/**
+ * @brief   Axis aligned box as minimum x, y, z and maximum x, y, z
+ *
+ */
+using MeshBox = std::array<float, 6>;
+
+/**
+ * @brief   Consecutive elements of a subobject with their bounding box. A batch is a polyline 
+ *          or face for Line and Face subobjects and a chunk of nearby entities for Point and Sphere
+ *
+ */
+struct MeshBatch {
+    int first = 0;
+    int count = 0;
+    // sID group of the subobject for Line and Face batches, -1 for Point and Sphere batches
+    int group = -1;
+    // Vertices of the polyline or face for Line and Face batches, their triangles do not
+    // start at the first vertex
+    int firstVertex = 0;
+    int numVertices = 0;
+    MeshBox box;
+};
+
+/**
+ * @brief   Range of a subobject in the buffers of a SnapshotMesh. Points are drawn from the
+ *          vertices, lines (as segments) and faces (as triangles) from the indices and
+ *          spheres from the instances
+ *
+ */
+struct MeshRange {
+    int object = 0;
+    int subObject = 0;
+    EntityType type = EntityType::Undefined;
+    int firstVertex = 0;
+    int numVertices = 0;
+    int firstIndex = 0;
+    int numIndices = 0;
+    int firstInstance = 0;
+    int numInstances = 0;
+    int firstBatch = 0;
+    int numBatches = 0;
+    MeshBox box;
+};
+
+/**
+ * @brief   View frustum given by the OpenGL projection and modelview matrices
+ *
+ */
+class Frustum
+{
+public:
+    enum class Side { Outside, Intersects, Inside };
+    /**
+     * @brief   Construct a new Frustum object
+     *
+     * @param projection    Projection matrix in column-major order
+     * @param modelview     Modelview matrix in column-major order
+     */
+    Frustum(const float* projection, const float* modelview);
+    /**
+     * @brief   Position of a box relative to the frustum. Boxes near a corner of the 
+     *          frustum can be reported as intersecting while being outside
+     *
+     * @param box   Box in model coordinates
+     * @return Side Outside, Intersects or Inside
+     */
+    Side Test(const MeshBox& box) const;
+private:
+    // Left, right, bottom, top, near and far planes as a, b, c, d with the inside positive
+    std::array<std::array<float, 4>, 6> planes;
+};
+
+/**
+ * @brief   Vertex and index buffers of the Point, Line and Face subobjects of a snapshot
+ *          and instance buffers of its Sphere subobjects
+ *
+ */
+class SnapshotMesh
+{
+public:
+    /**
+     * @brief   Construct an empty SnapshotMesh object
+     *
+     */
+    SnapshotMesh() {};
+    /**
+     * @brief   Construct a new SnapshotMesh object. Faces are triangulated by ear clipping,
+     *          so they can be concave
+     *
+     * @param snapshot      Snapshot to flatten
+     * @param scales        Scales applied to the coordinates. 2D data gets z = 0
+     * @param dictionary    Dictionary giving the label id of every entity
+     */
+    SnapshotMesh(const Snapshot& snapshot, const ScaleUnit& scales, const LabelDictionary& dictionary);
+    size_t NumVertices() const;
+    size_t NumInstances() const;
+    /**
+     * @brief   Positions buffer
+     *
+     * @return const std::vector<float>&    x, y, z coordinates of every vertex
+     */
+    const std::vector<float>& Positions() const;
+    /**
+     * @brief   Normal of the face of every vertex, parallel to the positions buffer
+     *
+     * @return const std::vector<std::int8_t>&   x, y, z, 0 of every vertex as signed normalized
+     *                                          bytes, zero for points and lines
+     */
+    const std::vector<std::int8_t>& Normals() const;
+    /**
+     * @brief   Label id of every vertex, parallel to the positions buffer
+     *
+     * @return const std::vector<int>&  Label ids, -1 for entities without label
+     */
+    const std::vector<int>& LabelIds() const;
+    /**
+     * @brief   Indices of the line segments and face triangles
+     *
+     * @return const std::vector<std::uint32_t>&   Vertex indices
+     */
+    const std::vector<std::uint32_t>& Indices() const;
+    /**
+     * @brief   Sphere instances buffer. Centers are scaled, radii are kept as in the file
+     *
+     * @return const std::vector<float>&    x, y, z of the center and radius of every sphere
+     */
+    const std::vector<float>& Instances() const;
+    /**
+     * @brief   Label id of every sphere, parallel to the instances buffer
+     *
+     * @return const std::vector<int>&  Label ids, -1 for entities without label
+     */
+    const std::vector<int>& InstanceLabelIds() const;
+    /**
+     * @brief   Ranges of the subobjects, ordered by object and subobject
+     *
+     * @return const std::vector<MeshRange>&    Subobjects ranges
+     */
+    const std::vector<MeshRange>& Ranges() const;
+    /**
+     * @brief   Batches of all the subobjects, every range refers to its own batches
+     *
+     * @return const std::vector<MeshBatch>&   Batches ordered by subobject
+     */
+    const std::vector<MeshBatch>& Batches() const;
+    /**
+     * @brief   Entity of every vertex, parallel to the positions buffer. It is the index of the 
+     *          entity in its subobject for Point subobjects and in its sID group (given by the 
+     *          batch) for Line and Face subobjects
+     *
+     * @return const std::vector<int>&  Entity indices
+     */
+    const std::vector<int>& VertexEntities() const;
+    /**
+     * @brief   Entity of every sphere, parallel to the instances buffer, as the index of the
+     *          entity in its subobject
+     *
+     * @return const std::vector<int>&  Entity indices
+     */
+    const std::vector<int>& InstanceEntities() const;
+    /**
+     * @brief   Range owning a batch
+     *
+     * @param batch     Index of the batch
+     * @return int      Index of the range
+     */
+    int RangeOfBatch(int batch) const;
+    /**
+     * @brief   Visible part of a subobject. The range box is tested first, then its batches. 
+     *          Consecutive visible batches are merged. Elements are indices for Line and Face, 
+     *          vertices for Point and instances for Sphere subobjects
+     *
+     * @param range     Range of the subobject
+     * @param frustum   View frustum
+     * @param first     First element of every visible run
+     * @param count     Number of elements of every visible run
+     */
+    void Cull(const MeshRange& range, const Frustum& frustum, std::vector<int>& first, std::vector<int>& count) const;
+    /**
+     * @brief   Runs of elements of a subobject given its visible batches, as returned by Cull
+     *
+     * @param range             Range of the subobject
+     * @param visibleBatches    Sorted indices of the visible batches of all the subobjects
+     * @param first             First element of every visible run
+     * @param count             Number of elements of every visible run
+     */
+    void Runs(const MeshRange& range, const std::vector<int>& visibleBatches, std::vector<int>& first, std::vector<int>& count) const;
+private:
+    void AddVertex(float x, float y, float z, const std::string& label, int entity);
+    void AddInstance(float x, float y, float z, float radius, const std::string& label, int entity);
+    void AddRun(const MeshBatch& batch, std::vector<int>& first, std::vector<int>& count) const;
+    int LabelId(const std::string& label);
+    void SortSpatially(MeshRange& range);
+    void AddBatches(MeshRange& range, int batchSize);
+    float xScale = 1.0;
+    float yScale = 1.0;
+    float zScale = 0.0;
+    const LabelDictionary* labels = nullptr;
+    // Consecutive entities usually share the label, the last lookup is reused
+    std::string lastLabel = "";
+    int lastLabelId = -1;
+    std::vector<float> positions;
+    std::vector<std::int8_t> normals;
+    std::vector<int> labelIds;
+    std::vector<int> entities;
+    std::vector<std::uint32_t> indices;
+    std::vector<float> instances;
+    std::vector<int> instanceLabelIds;
+    std::vector<int> instanceEntities;
+    std::vector<MeshRange> ranges;
+    std::vector<MeshBatch> batches;
+};
+
+}
@@ -15,8 +15,12 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <limits>
+#include <cstdint>
+#include <memory>
 #include <utility>
 #include "utils.h"
+#include "Labels.h"
 
 namespace BD5 {
 
@@ -34,6 +38,24 @@ enum class EntityType
     Undefined
 };
 
+/**
+ * @brief   The minimum and maximum coordinates of the geometry
+ * 
+ */
+struct Boundaries {
+    float maxX = std::numeric_limits<float>::min();
+    float maxY = std::numeric_limits<float>::min();
+    float maxZ = std::numeric_limits<float>::min();
+    float minX = std::numeric_limits<float>::max();
+    float minY = std::numeric_limits<float>::max();
+    float minZ = std::numeric_limits<float>::max();
+    void updateBoundaries(const Boundaries&);
+    void updateBoundaries(float x, float y, float z);
+    float centerX() const;
+    float centerY() const;
+    float centerZ() const;
+};
+
 /* 
     Insert the coordinates of the item in a map using
     the chars x, y, z and r (x-axis, y-axis, z-axis, radius)
@@ -114,6 +136,97 @@ struct EntityData {
     static EntityType GetEntityType(const std::string&);
 };
 
+/**
+ * @brief   Description of a polyline or face (the entities sharing an ID and sID).
+ *          It is stored out of band, in a table parallel to the entities grouped by sID,
+ *          so the vertex stream of a subobject only contains real vertices.
+ * 
+ */
+struct PolylineData {
+    std::string ID = "";
+    int sID = 0;
+    Boundaries box;
+    float centerX = 0.0;
+    float centerY = 0.0;
+    float centerZ = 0.0;
+};
+
+/**
+ * @brief   Quantized storage of Point, Circle and Sphere entities. Coordinates are stored as 16-bit
+ *          integers relative to the box of the subobject and radii relative to their range, 
+ *          the IDs as indices to the IDs dictionary of the file and the labels as indices to the
+ *          distinct labels of the subobject. 
+ *          Values are dequantized on the fly by the accessors.
+ * 
+ */
+class QuantizedEntities
+{
+public:
+    /**
+     * @brief   Quantize a vector of entities
+     * 
+     * @param entities  Point, Circle or Sphere entities
+     * @param IDs       Dictionary where the IDs are interned, the quantized entities share it
+     * @return QuantizedEntities    The quantized entities
+     */
+    static QuantizedEntities Quantize(const std::vector<EntityData>& entities, const std::shared_ptr<IDDictionary>& IDs);
+    /**
+     * @brief   Number of entities
+     * 
+     * @return size_t   Number of entities
+     */
+    size_t Size() const;
+    float X(size_t index) const;
+    float Y(size_t index) const;
+    float Z(size_t index) const;
+    float Radius(size_t index) const;
+    const std::string& ID(size_t index) const;
+    const std::string& Label(size_t index) const;
+    bool Is3D() const;
+    bool HasRadius() const;
+    /**
+     * @brief   Dequantize an entity
+     * 
+     * @param index     Index of the entity
+     * @return EntityData   The entity with dequantized values
+     */
+    EntityData Entity(size_t index) const;
+    /**
+     * @brief   Dequantize all the entities
+     * 
+     * @return std::vector<EntityData>  The entities with dequantized values
+     */
+    std::vector<EntityData> Dequantize() const;
+    /**
+     * @brief   Maximum absolute error of the dequantized coordinates and radii
+     * 
+     * @return float    Maximum absolute error (half of the quantization step)
+     */
+    float MaxError() const;
+    /**
+     * @brief   Memory of the arrays stored for every entity (coordinates, radii, ID and label
+     *          indices). The IDs dictionary and the distinct labels are not included
+     * 
+     * @return size_t   Size in bytes
+     */
+    size_t MemoryBytes() const;
+private:
+    float Dequantize(std::uint16_t value, float min, float max) const;
+    Boundaries box;
+    float minRadius = 0.0;
+    float maxRadius = 0.0;
+    bool hasZ = false;
+    bool hasRadius = false;
+    // Coordinates are stored as [entity]::[x, y, z]
+    std::vector<std::uint16_t> coordinates;
+    std::vector<std::uint16_t> radii;
+    // IDs and labels are stored once, every entity keeps an index to them
+    std::vector<std::uint32_t> IDIndices;
+    std::shared_ptr<const IDDictionary> IDs;
+    std::vector<std::uint32_t> labelIndices;
+    std::vector<std::string> labels;
+};
+
 /**
  * @brief   Class to represent an object (In a BD5 file an object is contained in a group. 
  *          And it has a list of datasets as components, 
@@ -131,15 +244,61 @@ class Object
 {
 public:
     void InsertObjectData(EntityType, const std::vector<std::vector<EntityData>>&);
+    void InsertObjectData(EntityType, const std::vector<std::vector<EntityData>>&, const std::vector<PolylineData>&);
     const std::vector<std::pair<EntityType, std::vector<std::vector<EntityData>>>>& GetAllSubObjects() const;
     const std::vector<std::vector<EntityData>>& GetSubObject(int) const;
     EntityType EntityTypeAtSubObject(int) const;
     const std::vector<EntityData>& GetEntitiesAtSubObjectNoSID(int) const;
     const std::vector<EntityData>& GetEntitiesAtSubObjectBySID(int, int) const;
+    /**
+     * @brief   Get the polylines/faces description of a subobject. There is one PolylineData
+     *          for every sID group of entities. It is empty for Point, Circle and Sphere subobjects.
+     * 
+     * @return const std::vector<PolylineData>&   Polylines description ordered as the sID groups
+     */
+    const std::vector<PolylineData>& GetPolylinesAtSubObject(int) const;
     int GetNumSubObjects() const;
+    /**
+     * @brief   Move the Point, Circle and Sphere subobjects to the quantized storage.
+     *          The entities vector of a quantized subobject is left empty.
+     * 
+     * @param IDs   Dictionary of the IDs of the file
+     */
+    void QuantizeSubObjects(const std::shared_ptr<IDDictionary>& IDs);
+    bool IsQuantizedSubObject(int) const;
+    const QuantizedEntities& GetQuantizedSubObject(int) const;
+    /**
+     * @brief   Maximum absolute error of the quantized subobjects
+     * 
+     * @return float    Maximum absolute error, 0 if there are no quantized subobjects
+     */
+    float QuantizationError() const;
+    /**
+     * @brief   Get the entities of a subobject grouped by sID. Quantized subobjects are dequantized.
+     * 
+     * @return std::vector<std::vector<EntityData>>     Entities of the subobject
+     */
+    std::vector<std::vector<EntityData>> GetSubObjectEntities(int) const;
+    /**
+     * @brief   Test if both objects share the same geometry block. Copies of an object 
+     *          and identical objects found at consecutive times share it.
+     * 
+     * @return  true 
+     * @return  false 
+     */
+    bool SharesGeometryWith(const Object&) const;
 private:
-    // Entities are stored as [first:object_type, second:Entities_list]::[sID (line and poly)]::[list_entities]
-    std::vector< std::pair<EntityType, std::vector<std::vector<EntityData>> > > data;
+    struct Geometry {
+        // Entities are stored as [first:object_type, second:Entities_list]::[sID (line and poly)]::[list_entities]
+        std::vector< std::pair<EntityType, std::vector<std::vector<EntityData>> > > data;
+        // Polylines are stored as [subobject]::[sID (line and poly)]
+        std::vector< std::vector<PolylineData> > polylines;
+        // Quantized storage for every subobject, empty when it is not quantized
+        std::vector<QuantizedEntities> quantized;
+    };
+    void Detach();
+    // Reference counted geometry, copying an Object does not copy its entities
+    std::shared_ptr<Geometry> geometry = std::make_shared<Geometry>();
 };
 
 }
\ No newline at end of file
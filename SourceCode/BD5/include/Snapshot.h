@@ -55,6 +55,13 @@ public:
      * @return const BD5::Object&   A reference to the object
      */
     const BD5::Object& GetObjectAt(int index) const;
+    /**
+     * @brief Replace the object at index
+     * 
+     * @param index     Index pointed in the vector
+     * @param object    The new object
+     */
+    void SetObjectAt(int index, const BD5::Object& object);
 private:
     float time = 0.0;
     std::vector<BD5::Object> objects;
@@ -0,0 +1,129 @@
+/**
+ * @file    SpatialIndex.h
+ * @author  Riken. Center for Biosystems Dynamics Research. Laboratory for Developmental Dynamics
+ * @brief   MeshHit struct and SpatialIndex class. A SpatialIndex is a bounding volume hierarchy over
+ *          the batches of a SnapshotMesh, used for hierarchical view frustum culling and for
+ *          box, radius and ray queries (selection and picking) without scanning the whole snapshot
+ * @version 0.1
+ * @date    2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include <vector>
+#include <limits>
+#include "Mesh.h"
+
+namespace BD5 {
+
+/**
+ * @brief   Element of a SnapshotMesh found by a query. The element is the instance of a sphere
+ *          or the vertex of a point, line or face (the nearest one to the hit for lines and faces).
+ *          SnapshotMesh::VertexEntities and InstanceEntities give the entity of the element and
+ *          the batch gives the sID group of lines and faces
+ *
+ */
+struct MeshHit {
+    int range = -1;
+    int batch = -1;
+    int element = -1;
+    // Distance along the ray for ray casts, to the center for radius queries, 0 for box queries
+    float distance = std::numeric_limits<float>::infinity();
+};
+
+/**
+ * @brief   Bounding volume hierarchy over the batches of a SnapshotMesh. The index only keeps
+ *          batch indices and boxes, queries are given the mesh it was built from
+ *
+ */
+class SpatialIndex
+{
+public:
+    /**
+     * @brief   Construct an empty SpatialIndex object
+     *
+     */
+    SpatialIndex() {};
+    /**
+     * @brief   Construct a new SpatialIndex object. Batches are split by the median of their
+     *          centers along the longest axis until a node has few batches
+     *
+     * @param batches   Batches of a SnapshotMesh
+     */
+    SpatialIndex(const std::vector<MeshBatch>& batches);
+    bool Empty() const;
+    size_t NumBatches() const;
+    size_t NumNodes() const;
+    /**
+     * @brief   Memory used by the nodes of the index
+     *
+     * @return size_t   Size in bytes
+     */
+    size_t MemoryBytes() const;
+    /**
+     * @brief   Time spent building the index
+     *
+     * @return double   Milliseconds
+     */
+    double BuildMilliseconds() const;
+    /**
+     * @brief   Batches inside or intersecting a frustum. Whole subtrees inside the frustum
+     *          are added without testing their batches
+     *
+     * @param frustum   View frustum
+     * @param visible   Sorted indices of the visible batches, as SnapshotMesh::Runs expects
+     */
+    void VisibleBatches(const Frustum& frustum, std::vector<int>& visible) const;
+    /**
+     * @brief   Elements with their position (sphere center) inside a box
+     *
+     * @param mesh  Mesh the index was built from
+     * @param box   Box in mesh coordinates
+     * @param hits  Elements found
+     */
+    void InBox(const SnapshotMesh& mesh, const MeshBox& box, std::vector<MeshHit>& hits) const;
+    /**
+     * @brief   Elements with their position (sphere center) at a distance from a point
+     *
+     * @param mesh      Mesh the index was built from
+     * @param center    x, y, z of the point in mesh coordinates
+     * @param radius    Maximum distance
+     * @param hits      Elements found
+     */
+    void InRadius(const SnapshotMesh& mesh, const float* center, float radius, std::vector<MeshHit>& hits) const;
+    /**
+     * @brief   Nearest element hit by a ray. Spheres and faces are hit exactly, points and lines
+     *          within a cone around the ray given by an angular tolerance
+     *
+     * @param mesh          Mesh the index was built from
+     * @param origin        x, y, z of the origin of the ray in mesh coordinates
+     * @param direction     x, y, z of the direction of the ray, normalized
+     * @param tolerance     Tangent of the half angle of the cone, e.g. pixel size / focal length
+     * @param hit           Nearest element, unchanged if nothing is hit
+     * @param ranges        Optional flag of every range of the mesh, ranges flagged false are not hit
+     * @return true         An element was hit
+     * @return false        Nothing was hit
+     */
+    bool RayCast(const SnapshotMesh& mesh, const float* origin, const float* direction, float tolerance, MeshHit& hit,
+                 const std::vector<bool>* ranges = nullptr) const;
+private:
+    // Nodes are stored depth first, the left child follows its parent. Leaves have no right
+    // child. Every node covers the items first to first + count - 1
+    struct Node {
+        MeshBox box;
+        int right = -1;
+        int first = 0;
+        int count = 0;
+    };
+    int Build(int first, int count);
+    std::vector<Node> nodes;
+    // Batch indices reordered so every subtree is contiguous
+    std::vector<int> items;
+    std::vector<MeshBox> boxes;
+    double buildMilliseconds = 0.0;
+};
+
+}
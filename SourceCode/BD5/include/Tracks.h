@@ -0,0 +1,139 @@
+/**
+ * @file    Tracks.h
+ * @author  Riken. Center for Biosystems Dynamics Research. Laboratory for Developmental Dynamics
+ * @brief   PointTrack struct and TrackStore class. A TrackStore keeps the points of all the tracks
+ *          in one contiguous coordinates buffer, every track is a range of the buffer sorted by time.
+ * @version 0.1
+ * @date    2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <iostream>
+#include <array>
+
+namespace BD5 {
+
+/**
+ * @brief   Description of a point in a track
+ * 
+ */
+struct PointTrack {
+    float x = 0.0;
+    float y = 0.0;
+    float z = 0.0;
+    int id = 0;
+    std::string objID = "";
+    std::string label = "";
+    void print(void) {
+        std::cout << " id " << id << " objID " << objID << " label " << label 
+            << " x " << x << " " << x*0.105 << " y " << y << " " << y*0.105 << " z " << z << " " << z*0.5 << std::endl;        
+    }
+};
+
+/**
+ * @brief   Columnar storage of tracks. Coordinates are stored as x, y, z for every point
+ * 
+ */
+class TrackStore
+{
+public:
+    /**
+     * @brief   Construct an empty TrackStore object
+     * 
+     */
+    TrackStore() {};
+    /**
+     * @brief   Construct a new TrackStore object
+     * 
+     * @param tracks    Tracks described as PointTrack. The points of every track are sorted by time
+     */
+    explicit TrackStore(const std::vector<std::vector<PointTrack>>& tracks);
+    /**
+     * @brief   Multiply the coordinates by the scales
+     * 
+     */
+    void Scale(float xScale, float yScale, float zScale);
+    size_t NumTracks() const;
+    size_t NumPoints() const;
+    /**
+     * @brief   Coordinates buffer of all the tracks
+     * 
+     * @return const float*     Pointer to the x, y, z coordinates of the first point
+     */
+    const float* Coordinates() const;
+    /**
+     * @brief   Time index of every point, parallel to the coordinates buffer
+     * 
+     * @return const int*   Pointer to the time of the first point
+     */
+    const int* Times() const;
+    /**
+     * @brief   Index of the first point of a track in the coordinates buffer
+     * 
+     * @param track Track index
+     * @return int  Point index
+     */
+    int Offset(size_t track) const;
+    /**
+     * @brief   Number of points of a track
+     * 
+     * @param track Track index
+     * @return int  Number of points
+     */
+    int Count(size_t track) const;
+    /**
+     * @brief   Number of points of a track with time lower or equal to t (binary search)
+     * 
+     * @param track Track index
+     * @param t     Time index
+     * @return int  Number of points of the visible prefix
+     */
+    int CountAtTime(size_t track, int t) const;
+    /**
+     * @brief   Number of points of a track with time lower than t (binary search). The points 
+     *          between FirstAtTime(t - n) and CountAtTime(t) are the tail of the last n times
+     * 
+     * @param track Track index
+     * @param t     Time index
+     * @return int  Index of the first point at t or later, relative to the track
+     */
+    int FirstAtTime(size_t track, int t) const;
+    /**
+     * @brief   Diagonal of the box enclosing a track
+     * 
+     * @param track Track index
+     * @return float    Length of the diagonal
+     */
+    float Extent(size_t track) const;
+    /**
+     * @brief   Center of the box enclosing a track
+     * 
+     * @param track Track index
+     * @return std::array<float, 3> x, y, z coordinates of the center
+     */
+    std::array<float, 3> Center(size_t track) const;
+    /**
+     * @brief   Simplified copy of the tracks (Douglas-Peucker). The points closer than the 
+     *          tolerance to the simplified line are removed, the first and last points are kept
+     * 
+     * @param relativeTolerance Tolerance relative to the Extent of every track
+     * @return TrackStore   Tracks with the same indices and fewer points
+     */
+    TrackStore Simplify(float relativeTolerance) const;
+private:
+    void ComputeBoxes();
+    std::vector<float> coordinates;
+    std::vector<int> times;
+    // Offsets of every track, the last one is the number of points
+    std::vector<int> offsets = {0};
+    // Minimum and maximum x, y, z of every track
+    std::vector<float> boxes;
+};
+
+}
@@ -1,5 +1,10 @@
 #include <iostream>
 #include <sstream>
+#include <string_view>
+#include <functional>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 #include "BD5File.h"
 #include "DataSet.h"
 #include "utils.h"
@@ -9,29 +14,6 @@ using namespace H5;
 using namespace BD5;
 
 
-void Boundaries::updateBoundaries(const Boundaries& newBoundaries)
-{
-    if (newBoundaries.minX < minX) {
-        minX = newBoundaries.minX;
-    }
-    if (newBoundaries.maxX > maxX) {
-        maxX = newBoundaries.maxX;
-    }
-    if (newBoundaries.minY < minY) {
-        minY = newBoundaries.minY;
-    }
-    if (newBoundaries.maxY > maxY) {
-        maxY = newBoundaries.maxY;
-    }
-    if (newBoundaries.minZ < minZ) {
-        minZ = newBoundaries.minZ;
-    }
-    if (newBoundaries.maxZ > maxZ) {
-        maxZ = newBoundaries.maxZ;
-    }
-}
-
-
 BD5File::BD5File() :
     logger(settings.LOG_FILE)
 {   
@@ -157,67 +139,121 @@ std::vector<std::string> BD5File::GetObjNames(BD5::DataSet& dataset) {
     return names;
 }
 
-std::vector<std::vector<PointTrack>> BD5File::WriteTracksGeometry(const std::vector<std::vector<string>>& tracks, const std::vector<PointTrack>& pntTracks) 
+std::vector<std::vector<PointTrack>> BD5File::WriteTracksGeometry(const std::vector<std::vector<string>>& tracks, const std::vector<PointTrack>& pntTracks) const
 {
-    vector<vector<PointTrack>> vecTracks;
-
-    for(auto& track: tracks) {
-        vector<PointTrack> vecLine;
-        for (auto& lineStr: track) {
-            auto it = std::find_if(pntTracks.begin(), pntTracks.end(),
-                [&lineStr](const PointTrack& row) {
-                    return ( row.objID == lineStr);
-                });
-            if (it != pntTracks.end()) {
-                vecLine.push_back(*it);
-            }
-            else {
-                std::ostringstream ss;
-                ss << __FILE__ << ":" << __func__ << "() " << "Not found lineStr " << lineStr;
-                logger.log( string(ss.str()), LogType::ERR);
+    // First point of every lineage ID, indexed by the node of the ID in the lineage graph
+    vector<int> pointAtNode(lineage.Size(), -1);
+    for (size_t i = 0; i < pntTracks.size(); i++) {
+        int node = lineage.Find(pntTracks[i].objID);
+        if ( (node >= 0) && (pointAtNode[node] < 0) ) {
+            pointAtNode[node] = static_cast<int>(i);
+        }
+    }
+
+    vector<vector<PointTrack>> vecTracks(tracks.size());
+    vector<vector<string>> notFound(tracks.size());
+    auto assembleTracks = [&](size_t first, size_t last) {
+        for (size_t t = first; t < last; t++) {
+            auto& vecLine = vecTracks[t];
+            vecLine.reserve(tracks[t].size());
+            for (auto& lineStr: tracks[t]) {
+                int node = lineage.Find(lineStr);
+                if ( (node >= 0) && (pointAtNode[node] >= 0) ) {
+                    vecLine.push_back(pntTracks[pointAtNode[node]]);
+                }
+                else {
+                    notFound[t].push_back(lineStr);
+                }
             }
         }
-        vecTracks.push_back(vecLine);
+    };
+
+    // Tracks are independent, large sets are assembled in parallel
+    const size_t minTracksPerThread = 1024;
+    size_t numThreads = std::min<size_t>( std::max(1u, std::thread::hardware_concurrency()),
+                                          tracks.size() / minTracksPerThread );
+    if (numThreads <= 1) {
+        assembleTracks(0, tracks.size());
+    }
+    else {
+        vector<std::thread> workers;
+        size_t chunk = (tracks.size() + numThreads - 1) / numThreads;
+        for (size_t first = 0; first < tracks.size(); first += chunk) {
+            workers.emplace_back(assembleTracks, first, std::min(first + chunk, tracks.size()));
+        }
+        for (auto& worker: workers) {
+            worker.join();
+        }
+    }
+
+    for (auto& trackNotFound: notFound) {
+        for (auto& lineStr: trackNotFound) {
+            std::ostringstream ss;
+            ss << __FILE__ << ":" << __func__ << "() " << "Not found lineStr " << lineStr;
+            logger.log( string(ss.str()), LogType::ERR);
+        }
     }
     return vecTracks;
 }
 
-std::vector<PointTrack> BD5File::WriteTrackInfo(int timeId, const std::vector<std::vector<EntityData>>& geometry) 
+std::vector<PointTrack> BD5File::WriteTrackInfo(int timeId, const std::vector<std::vector<EntityData>>& geometry,
+                                                const std::vector<PolylineData>& polylines) const
 {
     vector<PointTrack> tracksGeom;
+    // Position in tracksGeom of every ID
+    unordered_map<string, size_t> pointIndex;
 
     for (auto& obj: geometry) {
-        std::for_each(obj.begin(), obj.end(), 
-                [&](const EntityData& element) {
-            auto it = std::find_if(tracksGeom.begin(), tracksGeom.end(), 
-                [&](const PointTrack& pointTrack) {
-                return (pointTrack.objID == element.ID);
-            });
-            if (it == tracksGeom.end()) {
-                // Polylines write the center of a sID polyline as a special
-                // line with very special ID and Label (this is not a point in 
-                // the line it is the center of the polyline)
-                if ( (element.ID == "XXBoxCenterXX") && (element.Label == "XXLocalBCenterXX") ) {
-                    PointTrack last = tracksGeom[tracksGeom.size()-1];
-                    last.x = element.X();
-                    last.y = element.Y();
-                    last.z = element.Z();
-                    tracksGeom.pop_back();
-                    tracksGeom.push_back(last);
-                } 
-                else {
-                    PointTrack pT = { .x = element.X(), .y = element.Y(), .z = element.Z(),
-                                      .id = timeId, .objID = element.ID, .label = element.Label,
-                                    };
-                    tracksGeom.push_back(pT);
-                }
+        for (auto& element: obj) {
+            if (pointIndex.find(element.ID) == pointIndex.end()) {
+                PointTrack pT = { .x = element.X(), .y = element.Y(), .z = element.Z(),
+                                  .id = timeId, .objID = element.ID, .label = element.Label,
+                                };
+                pointIndex.insert( {element.ID, tracksGeom.size()} );
+                tracksGeom.push_back(pT);
             }
-        });
+        }
+    }
+
+    // Polylines and faces are tracked by the center of the box enclosing 
+    // all the sIDs sharing the same ID (this is not a point in the line)
+    for (size_t i = 0; i < polylines.size(); ) {
+        Boundaries box = polylines[i].box;
+        size_t j = i + 1;
+        while ( (j < polylines.size()) && (polylines[j].ID == polylines[i].ID) ) {
+            box.updateBoundaries(polylines[j].box);
+            j++;
+        }
+        auto it = pointIndex.find(polylines[i].ID);
+        if (it != pointIndex.end()) {
+            auto& pointTrack = tracksGeom[it->second];
+            pointTrack.x = box.centerX();
+            pointTrack.y = box.centerY();
+            pointTrack.z = box.centerZ();
+        }
+        i = j;
     }
 
     return tracksGeom;
 }
 
+std::vector<PointTrack> BD5File::WriteTrackInfo(int timeId, const BD5::QuantizedEntities& entities) const
+{
+    // Quantized subobjects are points, circles or spheres, they have no polylines
+    vector<PointTrack> tracksGeom;
+    unordered_set<string_view> found;
+    for (size_t i = 0; i < entities.Size(); i++) {
+        auto& ID = entities.ID(i);
+        if (found.insert(ID).second) {
+            PointTrack pT = { .x = entities.X(i), .y = entities.Y(i), .z = entities.Is3D() ? entities.Z(i) : 0.0f,
+                              .id = timeId, .objID = ID, .label = entities.Label(i),
+                            };
+            tracksGeom.push_back(pT);
+        }
+    }
+    return tracksGeom;
+}
+
 
 std::vector<std::pair<string, string>> BD5File::GetRawTrackInfo(BD5::DataSet& dataset) 
 {
@@ -233,32 +269,14 @@ std::vector<std::pair<string, string>> BD5File::GetRawTrackInfo(BD5::DataSet& da
 
 std::vector<std::vector<string>> BD5File::MakeTrackPaths(const std::vector<std::pair<string, string>>& tracks)
 {
-    vector<vector<string>> tracksGraph;
-    for (size_t i = 0; i < tracks.size(); i++) {
-        if (i < tracks.size() - 2) {
-            auto tail = slice(tracks, i+1, tracks.size()-1);
-            auto it = std::find_if(tail.begin(), tail.end(), 
-                        [&tracks, &i](const pair<string, string>& tLine) {
-                            return (tLine.first == tracks[i].first);
-                        });
-            if (it != tail.end()) {
-                tracksGraph.push_back({tracks[i].first, tracks[i].second});
-                tracksGraph.push_back({tracks[i].first});  // The second element is fill in after
-                continue;
-            }
-        }
-        auto lineIndex = std::find_if(tracksGraph.rbegin(), tracksGraph.rend(),
-                        [&tracks, &i](const vector<string>& tLine) {
-                            return (tLine[tLine.size()-1] == tracks[i].first);
-                        });
-        if (lineIndex != tracksGraph.rend()) {
-            lineIndex->push_back(tracks[i].second);
-        }
-        else {
-            tracksGraph.push_back({tracks[i].first, tracks[i].second});
-        }
+    lineage = LineageGraph(tracks);
+    if (settings.BD5FILE_INFO_FLAG)
+    {
+        std::ostringstream ss;
+        ss << __FILE__ << ":" << __func__ << "() " << "Lineage nodes " << lineage.Size() << " links " << lineage.NumLinks();
+        logger.log(string(ss.str()), LogType::INFO);
     }
-    return tracksGraph;
+    return lineage.Paths();
 }
 
 
@@ -388,6 +406,14 @@ vector<BD5::Snapshot> BD5File::Read()
 {
     vector<BD5::Snapshot> snapshots;
     labels.clear();
+    labelDictionary.Clear();
+    tracks.clear();
+    trackLines.clear();
+    lineage = LineageGraph();
+    quantizationError = 0.0;
+    idDictionary = std::make_shared<IDDictionary>();
+    quantizedEntities = 0;
+    quantizedBytes = 0;
 
     try
     {
@@ -409,7 +435,6 @@ vector<BD5::Snapshot> BD5File::Read()
 
         objNames = GetObjNames(objDef);
 
-        vector<vector<string>> trackLines;
         auto rootDatasets = dataGroup.Datasets();
         if (std::find(rootDatasets.begin(), rootDatasets.end(), "trackInfo") != rootDatasets.end()) {
             auto trackDataset = ReadDataSet(settings.TRACK_INFO);
@@ -417,262 +442,355 @@ vector<BD5::Snapshot> BD5File::Read()
             trackLines = MakeTrackPaths(rawTrackInfo);
         }
 
+        timeGroups = dataGroup.Groups();
+        lastDecoded.clear();
+        sharedObjects = 0;
+        int skippedObjects = 0;
+
         // Snapshots capture
-        for (auto& group: dataGroup.Groups())
+        for (auto& group: timeGroups)
         {
             string currentGroup = settings.DATA + "/" + group + "/object";
 
             auto objectGroup = ReadGroup(currentGroup);
+            auto datasets = objectGroup.Datasets();
             vector<BD5::Object> objects;
             float objectTime = 0.0;
+            bool timeFound = false;
 
-            vector<vector<string>> currentObjLabels;
+            vector<LabelSet> currentObjLabels;
 
             // Objects (datasets inside timeId groups) capture
-            for (auto& dataset : objectGroup.Datasets())
+            for (size_t objIndex = 0; objIndex < datasets.size(); objIndex++)
+            {
+                // Hidden objects keep their index but are not decoded
+                if ( (objIndex < objNames.size()) && !IsObjectVisible(objNames[objIndex]) ) {
+                    objects.push_back(BD5::Object());
+                    currentObjLabels.push_back(LabelSet());
+                    skippedObjects++;
+                    continue;
+                }
+                LabelSet objLabels;
+                objects.push_back( ReadObjectDataset(currentGroup, datasets[objIndex], objectTime, objLabels) );
+                currentObjLabels.push_back(objLabels);
+                timeFound = true;
+            }
+
+            // All the objects are hidden, the snapshot still needs its time
+            if (!timeFound && !datasets.empty()) {
+                auto firstDataset = ReadDataSet(currentGroup + "/" + datasets.front());
+                objectTime = firstDataset.ExtractNumberAsAt<float>("t", 0);
+            }
+            labels.push_back(currentObjLabels);           
+            snapshots.push_back(BD5::Snapshot(objectTime, objects));
+        }
+        lastDecoded.clear();
+
+        if (settings.BD5FILE_INFO_FLAG)
+        {
+            std::ostringstream ss;
+            ss << __FILE__ << ":" << __func__ << "() " << "Max values scaled x= " << boundaries.maxX * scales.XScale() << " y= " << boundaries.maxY * scales.YScale() << " z= " << boundaries.maxZ * scales.ZScale();
+            ss << " Min values scaled x= " << boundaries.minX * scales.XScale() << " y= " << boundaries.minY * scales.YScale() << " z= " << boundaries.minZ * scales.ZScale();
+            logger.log(string(ss.str()), LogType::INFO);
+        }
+
+        if (settings.BD5FILE_INFO_FLAG)
+        {
+            std::ostringstream ss;
+            ss << __FILE__ << ":" << __func__ << "() " << "Object instances sharing the geometry of the previous time: " << sharedObjects;
+            ss << ". Hidden object instances not decoded: " << skippedObjects;
+            logger.log(string(ss.str()), LogType::INFO);
+        }
+
+        if (settings.QUANTIZED_STORAGE)
+        {
+            std::ostringstream ss;
+            ss << __FILE__ << ":" << __func__ << "() " << "Quantized storage. Maximum absolute error " << quantizationError;
+            ss << ". Entities " << quantizedEntities << " with " << idDictionary->Size() << " distinct IDs, "
+               << ((quantizedEntities > 0) ? static_cast<double>(quantizedBytes) / quantizedEntities : 0.0) << " bytes per entity";
+            logger.log(string(ss.str()), LogType::INFO);
+        }
+
+        return snapshots;
+    } 
+    catch(const FileIException& ex)
+    {
+        std::ostringstream ss;
+        ss << __FILE__ << ":" << __func__ << "() " << ex.getCDetailMsg();
+        logger.log( string(ss.str()), LogType::ERR);
+        throw;
+    } 
+    catch(const GroupIException& ex)
+    {
+        std::ostringstream ss;
+        ss << __FILE__ << ":" << __func__ << "() " << ex.getCDetailMsg();
+        logger.log( string(ss.str()), LogType::ERR);
+        throw;
+    } 
+    catch(const exception& ex)
+    {
+        std::ostringstream ss;
+        ss << __FILE__ << ":" << __func__ << "() " << ex.what();
+        logger.log( string(ss.str()), LogType::ERR);
+        throw;
+    }
+    catch(...)
+    {
+        throw;
+    }
+}
+
+
+BD5::Object BD5File::ReadObjectDataset(const string& group, const string& dataset, float& time, LabelSet& objLabels)
+{
+    string datasetPath = group + "/" + dataset;
+    if (settings.BD5FILE_INFO_FLAG)
+    {
+        std::ostringstream ss;
+        ss << __FILE__ << ":" << __func__ << "() " << "Dataset " << datasetPath;
+        logger.log(string(ss.str()), LogType::INFO);
+    }                
+    auto currentDataset = ReadDataSet(datasetPath);
+    time = currentDataset.ExtractNumberAsAt<float>("t", 0);
+
+    // The time member is the only one expected to change for static objects
+    auto masked = currentDataset.MaskedBuffer({"t"});
+    size_t hash = std::hash<std::string_view>{}(std::string_view(masked.data(), masked.size()));
+    auto decoded = lastDecoded.find(dataset);
+    if ( (decoded != lastDecoded.end()) && (decoded->second.hash == hash) && (decoded->second.buffer == masked) ) {
+        boundaries = decoded->second.box;
+        objLabels = decoded->second.labels;
+        sharedObjects++;
+        return decoded->second.object;
+    }
+
+    const string objectEntityStr = currentDataset.ExtractStringAt("entity", 0);
+    EntityType entityType = EntityData::GetEntityType(objectEntityStr);
+    vector<vector<EntityData>> groupedEntities;
+    vector<EntityData> vecZeroEntities; // For Point, Circle, Sphere
+    vector<EntityData> currentEntities; // For Line, Face
+    vector<PolylineData> polylines;     // For Line, Face (one per sID group)
+    int currentSID = -10000;
+    std::string currentID = "Nothing";
+    boundaries = Boundaries();
+    Boundaries box = Boundaries();
+
+    // Lambda function to describe the polyline (sID) just closed
+    // in the polylines table, parallel to the grouped entities
+    auto registerPolyline = [&](const vector<EntityData>& entities, struct Boundaries theBox) {
+        PolylineData polyline;
+        polyline.ID = entities.front().ID;
+        polyline.sID = currentSID;
+        polyline.box = theBox;
+        polyline.centerX = theBox.centerX();
+        polyline.centerY = theBox.centerY();
+        polyline.centerZ = theBox.centerZ();
+        polylines.push_back(polyline);
+    };
+
+    LabelSet currentLabels;
+    string currentLabel;
+    // Entities capture
+    for (int i = 0; i < currentDataset.NumItems(); i++)
+    {
+        string itemID = currentDataset.ExtractStringAt("ID", i);
+        string itemLabel;
+        if (currentDataset.ContainsElement("label"))
+            itemLabel = currentDataset.ExtractStringAt("label", i);
+        float cX = currentDataset.ExtractNumberAsAt<float>("x", i);
+        float cY = currentDataset.ExtractNumberAsAt<float>("y", i);
+        float cZ = 0.0f;
+
+        // Consecutive rows usually share the label, only lookup when it changes
+        if ( !itemLabel.empty() && (itemLabel != currentLabel) ) {
+            currentLabels.Insert( labelDictionary.Intern(itemLabel) );
+            currentLabel = itemLabel;
+        }
+
+        map<char, float> values = {{'x', cX},
+                                   {'y', cY}};
+
+        switch (entityType)
+        {
+            case EntityType::Point:
             {
-                string datasetPath = currentGroup + "/" + dataset;
-                if (settings.BD5FILE_INFO_FLAG)
+                if ( currentDataset.ContainsElement("z") )
                 {
-                    std::ostringstream ss;
-                    ss << __FILE__ << ":" << __func__ << "() " << "Dataset " << datasetPath;
-                    logger.log(string(ss.str()), LogType::INFO);
-                }                
-                auto currentDataset = ReadDataSet(datasetPath);
-                objectTime = currentDataset.ExtractNumberAsAt<float>("t", 0);
-                const string objectEntityStr = currentDataset.ExtractStringAt("entity", 0);
-                EntityType entityType = EntityData::GetEntityType(objectEntityStr);
-                vector<vector<EntityData>> groupedEntities;
-                vector<EntityData> vecZeroEntities; // For Point, Circle, Sphere
-                vector<EntityData> currentEntities; // For Line, Face
-                int currentSID = -10000;
-                std::string currentID = "Nothing";
-                boundaries = Boundaries();
-                Boundaries box = Boundaries();
-
-                auto calculateCenter = [&](struct Boundaries theBox) {
-                    std::map<char, float> center;
-                    float x = theBox.minX + (theBox.maxX - theBox.minX) / 2;
-                    float y = theBox.minY + (theBox.maxY - theBox.minY) / 2;
-                    float z = theBox.minZ + (theBox.maxZ - theBox.minZ) / 2;
-                    center.insert({'x', x});
-                    center.insert({'y', y});
-                    center.insert({'z', z});
-                    return center;
-                };
-
-                // Lambda function to write the center of a polylines
-                // as an additional line at the end of the entities vector (sID)
-                auto registerPolylineCenter = [&](struct Boundaries theBox) {
-                    std::map<char, float> center = calculateCenter(theBox);
-                    EntityData polylineCenter = {"XXBoxCenterXX", 
-                                                 "XXLocalBCenterXX", 
-                                                 center };
-                    currentEntities.push_back(polylineCenter);
-                };
-
-                vector<string> currentLabelsVector;
-                string currentLabel;
-                // Entities capture
-                for (int i = 0; i < currentDataset.NumItems(); i++)
+                    cZ = currentDataset.ExtractNumberAsAt<float>("z", i);
+                    values.insert( {'z', cZ} );
+                }                           
+                EntityData objData = { itemID, itemLabel, values };
+                vecZeroEntities.push_back(objData);
+            }
+            break;
+            case EntityType::Circle:
+            {
+                values.insert( {'r', currentDataset.ExtractNumberAsAt<float>("radius", i)} );
+                if ( currentDataset.ContainsElement("z") )
                 {
-                    string itemID = currentDataset.ExtractStringAt("ID", i);
-                    string itemLabel;
-                    if (currentDataset.ContainsElement("label"))
-                        itemLabel = currentDataset.ExtractStringAt("label", i);
-                    float cX = currentDataset.ExtractNumberAsAt<float>("x", i);
-                    float cY = currentDataset.ExtractNumberAsAt<float>("y", i);
-                    float cZ = 0.0f;
-
-                    if ( !itemLabel.empty() ) {
-                        if (itemLabel != currentLabel) {
-                            currentLabelsVector.push_back(itemLabel);
-                            currentLabel = itemLabel;
-                        }
-                        else {
-                            auto found = find(currentLabelsVector.begin(), currentLabelsVector.end(), itemLabel);
-                            if (found == currentLabelsVector.end()) {
-                                currentLabelsVector.push_back(itemLabel);
-                                currentLabel = itemLabel;
-                            }
-                        }
-                    }
+                    cZ = currentDataset.ExtractNumberAsAt<float>("z", i);
+                    values.insert( {'z', cZ});
+                }
 
-                    map<char, float> values = {{'x', cX},
-                                               {'y', cY}};
+                EntityData objData = { itemID, itemLabel, values };
+                vecZeroEntities.push_back(objData);
+            }
+            break;
+            case EntityType::Sphere:
+            {
+                cZ = currentDataset.ExtractNumberAsAt<float>("z", i);
+                values.insert( {'z', cZ} );
+                values.insert( {'r', currentDataset.ExtractNumberAsAt<float>("radius", i)} );
+                                     
+                EntityData objData = { itemID, itemLabel, values };
+                vecZeroEntities.push_back(objData);
+            }
+            break;
+            case EntityType::Line:
+            case EntityType::Face:
+            {
+                if ( currentDataset.ContainsElement("z") )
+                {
+                    cZ = currentDataset.ExtractNumberAsAt<float>("z", i);
+                    values.insert( {'z', cZ} );
+                }
 
-                    switch (entityType)
-                    {
-                        case EntityType::Point:
-                        {
-                            if ( currentDataset.ContainsElement("z") )
-                            {
-                                cZ = currentDataset.ExtractNumberAsAt<float>("z", i);
-                                values.insert( {'z', cZ} );
-                            }                           
-                            EntityData objData = { itemID, itemLabel, values };
-                            vecZeroEntities.push_back(objData);
-                        }
-                        break;
-                        case EntityType::Circle:
-                        {
-                            values.insert( {'r', currentDataset.ExtractNumberAsAt<float>("radius", i)} );
-                            if ( currentDataset.ContainsElement("z") )
-                            {
-                                cZ = currentDataset.ExtractNumberAsAt<float>("z", i);
-                                values.insert( {'z', cZ});
-                            }
-
-                            EntityData objData = { itemID, itemLabel, values };
-                            vecZeroEntities.push_back(objData);
-                        }
-                        break;
-                        case EntityType::Sphere:
-                        {
-                            cZ = currentDataset.ExtractNumberAsAt<float>("z", i);
-                            values.insert( {'z', cZ} );
-                            values.insert( {'r', currentDataset.ExtractNumberAsAt<float>("radius", i)} );
-                                                 
-                            EntityData objData = { itemID, itemLabel, values };
-                            vecZeroEntities.push_back(objData);
-                        }
-                        break;
-                        case EntityType::Line:
-                        case EntityType::Face:
-                        {
-                            if ( currentDataset.ContainsElement("z") )
-                            {
-                                cZ = currentDataset.ExtractNumberAsAt<float>("z", i);
-                                values.insert( {'z', cZ} );
-                            }
-
-                            EntityData objData = { itemID, itemLabel, values };
-
-                            if (i == 0) {
-                                if ( currentDataset.ContainsElement("sID") )
-                                {
-                                    currentSID = currentDataset.ExtractNumberAsAt<int>("sID", i);
-                                    currentID = itemID;
-                                }
-                                else {
-                                    std::ostringstream ss;
-                                    ss << __FILE__ << ":" << __func__ << "() " << "line/face does not define sID member element. H5 file incomplete data";
-                                    logger.log(string(ss.str()), LogType::ERR);
-                                    break;
-                                }
-                            }
-                            int sID = currentDataset.ExtractNumberAsAt<int>("sID", i);
-
-                            if ((sID != currentSID) || (currentID != itemID) )
-                            {
-                                if (currentID != itemID) {
-                                    if (i != 0) {
-                                        registerPolylineCenter(box);
-                                    }
-                                    box = Boundaries();
-                                }
-
-                                groupedEntities.push_back(currentEntities);
-                                currentEntities = vector<EntityData>{objData};
-                                currentSID = sID;
-                            }
-                            else
-                            {
-                                currentEntities.push_back(objData);
-                            }
-                            currentID = itemID;
-
-                            if (cX < box.minX) box.minX = cX;
-                            if (cX > box.maxX) box.maxX = cX;
-                            if (cY < box.minY) box.minY = cY;
-                            if (cY > box.maxY) box.maxY = cY;
-                            if (cZ < box.minZ) box.minZ = cZ;
-                            if (cZ > box.maxZ) box.maxZ = cZ;
-                        }
-                        break;
-                        case EntityType::Undefined:
-                            {
-                            std::ostringstream ss;
-                            ss << __FILE__ << ":" << __func__ << "() " << "Object type undefined";
-                            logger.log(string(ss.str()), LogType::WARN);
-                            break;
-                            }
-                    }
+                EntityData objData = { itemID, itemLabel, values };
 
-                    if ( (entityType == EntityType::Line) || 
-                         (entityType == EntityType::Face)) {
-                        boundaries.updateBoundaries(box);
+                if (i == 0) {
+                    if ( currentDataset.ContainsElement("sID") )
+                    {
+                        currentSID = currentDataset.ExtractNumberAsAt<int>("sID", i);
+                        currentID = itemID;
                     }
                     else {
-                        if (cX < boundaries.minX) boundaries.minX = cX;
-                        if (cX > boundaries.maxX) boundaries.maxX = cX;
-                        if (cY < boundaries.minY) boundaries.minY = cY;
-                        if (cY > boundaries.maxY) boundaries.maxY = cY;
-                        if (cZ < boundaries.minZ) boundaries.minZ = cZ;
-                        if (cZ > boundaries.maxZ) boundaries.maxZ = cZ;
+                        std::ostringstream ss;
+                        ss << __FILE__ << ":" << __func__ << "() " << "line/face does not define sID member element. H5 file incomplete data";
+                        logger.log(string(ss.str()), LogType::ERR);
+                        break;
                     }
                 }
+                int sID = currentDataset.ExtractNumberAsAt<int>("sID", i);
 
-                currentObjLabels.push_back(currentLabelsVector);
+                if ((sID != currentSID) || (currentID != itemID) )
+                {
+                    registerPolyline(currentEntities, box);
+                    box = Boundaries();
 
-                switch (entityType)
+                    groupedEntities.push_back(currentEntities);
+                    currentEntities = vector<EntityData>{objData};
+                    currentSID = sID;
+                }
+                else
                 {
-                    case EntityType::Point:
-                    case EntityType::Circle:
-                    case EntityType::Sphere:
-                        {
-                        groupedEntities = vector<vector<BD5::EntityData>>{ vecZeroEntities };
-
-                        if (settings.BD5FILE_INFO_FLAG)
-                        {
-                            std::ostringstream ss;
-                            ss << __FILE__ << ":" << __func__ << "() " << "Entities: " << vecZeroEntities.size();
-                            logger.log(string(ss.str()), LogType::INFO);
-                        }
-                        }
-                        break;
-                    case EntityType::Line:
-                    case EntityType::Face:
-                        {
-                        // Do not forget to include last element
-                        auto front = currentEntities.front();
-                        registerPolylineCenter(box);
-                        box = Boundaries();
-                        groupedEntities.push_back(currentEntities);
-
-                        if (settings.BD5FILE_INFO_FLAG)
-                        {
-                            std::ostringstream ss;
-                            ss << __FILE__ << ":" << __func__ << "() " << "Entities: " << currentEntities.size();
-                            logger.log(string(ss.str()), LogType::INFO);
-                        }
-                        break;
-                        }
-                    case EntityType::Undefined:
-                        break;
+                    currentEntities.push_back(objData);
                 }
+                currentID = itemID;
 
-                BD5::Object currentObject = Object();
-                currentObject.InsertObjectData(entityType, groupedEntities);
-                objects.push_back(currentObject);
+                box.updateBoundaries(cX, cY, cZ);
             }
-            labels.push_back(currentObjLabels);           
-            snapshots.push_back(BD5::Snapshot(objectTime, objects));
+            break;
+            case EntityType::Undefined:
+                {
+                std::ostringstream ss;
+                ss << __FILE__ << ":" << __func__ << "() " << "Object type undefined";
+                logger.log(string(ss.str()), LogType::WARN);
+                break;
+                }
+        }
+
+        if ( (entityType == EntityType::Line) || 
+             (entityType == EntityType::Face)) {
+            boundaries.updateBoundaries(box);
         }
+        else {
+            boundaries.updateBoundaries(cX, cY, cZ);
+        }
+    }
+
+    objLabels = currentLabels;
+
+    switch (entityType)
+    {
+        case EntityType::Point:
+        case EntityType::Circle:
+        case EntityType::Sphere:
+            {
+            groupedEntities = vector<vector<BD5::EntityData>>{ vecZeroEntities };
+
+            if (settings.BD5FILE_INFO_FLAG)
+            {
+                std::ostringstream ss;
+                ss << __FILE__ << ":" << __func__ << "() " << "Entities: " << vecZeroEntities.size();
+                logger.log(string(ss.str()), LogType::INFO);
+            }
+            }
+            break;
+        case EntityType::Line:
+        case EntityType::Face:
+            {
+            // Do not forget to include last element
+            if (!currentEntities.empty()) {
+                registerPolyline(currentEntities, box);
+                groupedEntities.push_back(currentEntities);
+            }
+            box = Boundaries();
+
+            if (settings.BD5FILE_INFO_FLAG)
+            {
+                std::ostringstream ss;
+                ss << __FILE__ << ":" << __func__ << "() " << "Entities: " << currentEntities.size();
+                logger.log(string(ss.str()), LogType::INFO);
+            }
+            break;
+            }
+        case EntityType::Undefined:
+            break;
+    }
+
+    BD5::Object currentObject = Object();
+    currentObject.InsertObjectData(entityType, groupedEntities, polylines);
+    if (settings.QUANTIZED_STORAGE) {
+        currentObject.QuantizeSubObjects(idDictionary);
+        quantizationError = std::max(quantizationError, currentObject.QuantizationError());
+        for (int i = 0; i < currentObject.GetNumSubObjects(); i++) {
+            if (currentObject.IsQuantizedSubObject(i)) {
+                quantizedEntities += currentObject.GetQuantizedSubObject(i).Size();
+                quantizedBytes += currentObject.GetQuantizedSubObject(i).MemoryBytes();
+            }
+        }
+    }
+    lastDecoded[dataset] = DecodedObject{ hash, std::move(masked), currentObject, currentLabels, boundaries };
+    return currentObject;
+}
+
+void BD5File::ReadObject(int objIndex, vector<BD5::Snapshot>& snapshots)
+{
+    try
+    {
+        // Bounds are the ones found by Read, the object is materialised in place
+        Boundaries readBoundaries = boundaries;
+        lastDecoded.clear();
+        for (size_t t = 0; (t < timeGroups.size()) && (t < snapshots.size()); t++)
+        {
+            string currentGroup = settings.DATA + "/" + timeGroups[t] + "/object";
+            auto datasets = ReadGroup(currentGroup).Datasets();
+            float objectTime = 0.0;
+            LabelSet objLabels;
+
+            auto object = ReadObjectDataset(currentGroup, datasets.at(objIndex), objectTime, objLabels);
+            snapshots[t].SetObjectAt(objIndex, object);
+            labels.at(t).at(objIndex) = objLabels;
+        }
+        lastDecoded.clear();
+        boundaries = readBoundaries;
 
         if (settings.BD5FILE_INFO_FLAG)
         {
             std::ostringstream ss;
-            ss << __FILE__ << ":" << __func__ << "() " << "Max values scaled x= " << boundaries.maxX * scales.XScale() << " y= " << boundaries.maxY * scales.YScale() << " z= " << boundaries.maxZ * scales.ZScale();
-            ss << " Min values scaled x= " << boundaries.minX * scales.XScale() << " y= " << boundaries.minY * scales.YScale() << " z= " << boundaries.minZ * scales.ZScale();
+            ss << __FILE__ << ":" << __func__ << "() " << "Object " << objIndex << " decoded for " << snapshots.size() << " snapshots";
             logger.log(string(ss.str()), LogType::INFO);
         }
-
-        if (!trackLines.empty()) {
-            tracks = CreateTracks(snapshots, trackLines);
-        }
-
-        return snapshots;
     } 
     catch(const FileIException& ex)
     {
@@ -701,30 +819,68 @@ vector<BD5::Snapshot> BD5File::Read()
     }
 }
 
+void BD5File::ReleaseObject(int objIndex, vector<BD5::Snapshot>& snapshots)
+{
+    // Labels are kept, so the labels panel and colors do not change while the object is hidden
+    for (auto& snapshot: snapshots) {
+        snapshot.SetObjectAt(objIndex, BD5::Object());
+    }
+}
+
+void BD5File::SetObjectVisibility(const string& name, bool flag)
+{
+    if (flag) {
+        hiddenObjects.erase(name);
+    }
+    else {
+        hiddenObjects.insert(name);
+    }
+}
 
-vector<vector<PointTrack>> BD5File::CreateTracks(const std::vector<BD5::Snapshot>& snapshots, const std::vector<std::vector<std::string>>& tLines)
+bool BD5File::IsObjectVisible(const string& name) const
+{
+    return hiddenObjects.find(name) == hiddenObjects.end();
+}
+
+
+vector<vector<PointTrack>> BD5File::CreateTracks(const std::vector<BD5::Snapshot>& snapshots) const
 {
     int t = 0;
     vector<PointTrack> tracks;
     // int total = 0;
     for (auto& snapshot: snapshots) {
-        auto objects = snapshot.GetObjects();
+        auto& objects = snapshot.GetObjects();
         for (auto& obj: objects ) {
             int numSubObj = obj.GetNumSubObjects();
             for (int i = 0; i < numSubObj; i++) {
-                auto subObj = obj.GetSubObject(i);
-                auto currTracks = WriteTrackInfo(t, subObj);
+                // Entities are read in place, quantized ones through their accessors
+                auto currTracks = obj.IsQuantizedSubObject(i) ? WriteTrackInfo(t, obj.GetQuantizedSubObject(i)) :
+                                                                WriteTrackInfo(t, obj.GetSubObject(i), obj.GetPolylinesAtSubObject(i));
                 // total = total + currTracks.size();
-                tracks.insert(tracks.end(), currTracks.begin(), currTracks.end());
+                tracks.insert(tracks.end(), std::make_move_iterator(currTracks.begin()), std::make_move_iterator(currTracks.end()));
             }
         }
         t++;
     }
 
-    auto fullTracks = WriteTracksGeometry(tLines, tracks);
+    auto fullTracks = WriteTracksGeometry(trackLines, tracks);
     return fullTracks;
 }
 
+void BD5File::SetTracks(const std::vector<std::vector<PointTrack>>& in_Tracks)
+{
+    tracks = in_Tracks;
+    // Time of the first point of every lineage ID
+    for (auto& track: tracks) {
+        for (auto& point: track) {
+            int node = lineage.Find(point.objID);
+            if ( (node >= 0) && ((lineage.Time(node) < 0) || (point.id < lineage.Time(node))) ) {
+                lineage.SetTime(node, point.id);
+            }
+        }
+    }
+}
+
 
 
 BD5::DataSet BD5File::ReadDataSet(const string& setPath)
@@ -856,9 +1012,16 @@ BD5::Boundaries BD5File::GetBoundaries() const
     return boundaries;
 }
 
+void BD5File::LogInfo(const string& entry) const
+{
+    if (settings.BD5FILE_INFO_FLAG) {
+        logger.log(entry, LogType::INFO);
+    }
+}
+
 bool BD5File::HasTracks() const
 {
-    return !tracks.empty();
+    return !trackLines.empty();
 }
 
 vector<vector<PointTrack>> BD5File::GetTracks() const
@@ -866,7 +1029,32 @@ vector<vector<PointTrack>> BD5File::GetTracks() const
     return tracks;
 }
 
+const LineageGraph& BD5File::GetLineage() const
+{
+    return lineage;
+}
+
 vector<vector<string>> BD5File::GetLabelsAtTime(int t) {
+    try {
+        vector<vector<string>> names;
+        for (auto& objLabels: labels.at(t)) {
+            vector<string> objNames;
+            for (auto id: objLabels.Ids()) {
+                objNames.push_back(labelDictionary.Name(id));
+            }
+            names.push_back(objNames);
+        }
+        return names;
+    }
+    catch(const exception& ex) {
+        std::ostringstream ss;
+        ss << __FILE__ << ":" << __func__ << "() " << ex.what();
+        logger.log( string(ss.str()), LogType::ERR);
+        throw;
+    }
+}
+
+const vector<LabelSet>& BD5File::GetLabelSetsAtTime(int t) {
     try {
         return labels.at(t);
     }
@@ -877,3 +1065,18 @@ vector<vector<string>> BD5File::GetLabelsAtTime(int t) {
         throw;
     }
 }
+
+const LabelDictionary& BD5File::GetLabelDictionary() const
+{
+    return labelDictionary;
+}
+
+void BD5File::SetQuantizedStorage(bool flag)
+{
+    settings.QUANTIZED_STORAGE = flag;
+}
+
+float BD5File::QuantizationError() const
+{
+    return quantizationError;
+}
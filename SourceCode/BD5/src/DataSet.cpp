@@ -83,6 +83,22 @@ std::string DataSet::ExtractStringAt(const std::string& name, int row)
     }
 }
 
+vector<char> DataSet::MaskedBuffer(const vector<string>& excluded) const
+{
+    vector<char> masked(*dataBuffer);
+    size_t rowSize = typeDescriptor.Size();
+    for (auto& name: excluded) {
+        if (!typeDescriptor.ContainsElement(name)) {
+            continue;
+        }
+        size_t offset = typeDescriptor.ElementOffset(name);
+        size_t size = typeDescriptor.ElementSize(name);
+        for (size_t row = 0; (row + 1) * rowSize <= masked.size(); row++) {
+            std::fill_n(masked.begin() + row * rowSize + offset, size, 0);
+        }
+    }
+    return masked;
+}
 
 void DataSet::ShowBuffer() const
 {
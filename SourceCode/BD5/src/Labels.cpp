@@ -0,0 +1,112 @@
+#include <sstream>
+#include <stdexcept>
+#include "Labels.h"
+
+using namespace std;
+using namespace BD5;
+
+int LabelDictionary::Intern(const std::string& label)
+{
+    auto found = ids.find(label);
+    if (found != ids.end()) {
+        return found->second;
+    }
+    int id = static_cast<int>(names.size());
+    names.push_back(label);
+    ids.insert( {label, id} );
+    return id;
+}
+
+int LabelDictionary::Find(const std::string& label) const
+{
+    auto found = ids.find(label);
+    return (found != ids.end()) ? found->second : -1;
+}
+
+const std::string& LabelDictionary::Name(int id) const
+{
+    try
+    {
+        return names.at(id);
+    }
+    catch(const out_of_range& ex)
+    {
+        ostringstream ss;
+        ss << __FILE__ << ":" << __func__ << "() " << "Label not found. Dictionary size " << names.size() << " with id " << id;
+        throw new std::out_of_range(string(ss.str()));
+    }
+}
+
+int LabelDictionary::Size() const
+{
+    return names.size();
+}
+
+void LabelDictionary::Clear()
+{
+    names.clear();
+    ids.clear();
+}
+
+
+void LabelSet::Insert(int id)
+{
+    size_t word = static_cast<size_t>(id) / 64;
+    if (word >= words.size()) {
+        words.resize(word + 1, 0);
+    }
+    words[word] |= (std::uint64_t(1) << (id % 64));
+}
+
+bool LabelSet::Contains(int id) const
+{
+    size_t word = static_cast<size_t>(id) / 64;
+    if ( (id < 0) || (word >= words.size()) ) {
+        return false;
+    }
+    return (words[word] >> (id % 64)) & 1;
+}
+
+int LabelSet::Count() const
+{
+    int count = 0;
+    for (auto word: words) {
+        while (word) {
+            word &= word - 1;
+            count++;
+        }
+    }
+    return count;
+}
+
+vector<int> LabelSet::Ids() const
+{
+    vector<int> result;
+    for (size_t i = 0; i < words.size(); i++) {
+        for (int bit = 0; bit < 64; bit++) {
+            if ((words[i] >> bit) & 1) {
+                result.push_back(static_cast<int>(i * 64 + bit));
+            }
+        }
+    }
+    return result;
+}
+
+bool LabelSet::operator==(const LabelSet& other) const
+{
+    // Trailing empty words do not change the set
+    const auto& shorter = (words.size() < other.words.size()) ? words : other.words;
+    const auto& longer = (words.size() < other.words.size()) ? other.words : words;
+    for (size_t i = 0; i < longer.size(); i++) {
+        std::uint64_t value = (i < shorter.size()) ? shorter[i] : 0;
+        if (longer[i] != value) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool LabelSet::operator!=(const LabelSet& other) const
+{
+    return !(*this == other);
+}
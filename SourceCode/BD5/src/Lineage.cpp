@@ -0,0 +1,195 @@
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include "Lineage.h"
+
+using namespace std;
+using namespace BD5;
+
+LineageGraph::LineageGraph(const vector<pair<string, string>>& in_Links)
+{
+    nodes.reserve(in_Links.size() + 1);
+    ids.reserve(in_Links.size() + 1);
+    links.reserve(in_Links.size());
+    for (auto& [from, to]: in_Links) {
+        int parent = Intern(from);
+        int child = Intern(to);
+        auto& children = nodes[parent].children;
+        if (std::find(children.begin(), children.end(), child) != children.end()) {
+            continue;
+        }
+        children.push_back(child);
+        nodes[child].parents.push_back(parent);
+        links.push_back( {parent, child} );
+    }
+    BuildIndex();
+}
+
+void LineageGraph::BuildIndex()
+{
+    size_t size = nodes.size();
+    preorder.clear();
+    preorder.reserve(size);
+    tourIn.assign(size, -1);
+    tourOut.assign(size, -1);
+    depth.assign(size, 0);
+    generation.assign(size, 0);
+    divisions.clear();
+    times.assign(size, -1);
+
+    // Iterative depth-first traversal, lineages can be millions of links deep.
+    // The tree children of a node are the children having it as first parent
+    vector<pair<int, size_t>> stack;
+    for (size_t root = 0; root < size; root++) {
+        if (!nodes[root].IsRoot()) {
+            continue;
+        }
+        tourIn[root] = preorder.size();
+        preorder.push_back(root);
+        stack.push_back( {static_cast<int>(root), 0} );
+        while (!stack.empty()) {
+            auto& [node, next] = stack.back();
+            auto& children = nodes[node].children;
+            if (next == children.size()) {
+                tourOut[node] = preorder.size();
+                if (nodes[node].IsDivision()) {
+                    divisions.push_back(node);
+                }
+                stack.pop_back();
+                continue;
+            }
+            int child = children[next++];
+            if ( (nodes[child].parents.front() != node) || (tourIn[child] >= 0) ) {
+                continue;
+            }
+            tourIn[child] = preorder.size();
+            depth[child] = depth[node] + 1;
+            generation[child] = generation[node] + (nodes[node].IsDivision() ? 1 : 0);
+            preorder.push_back(child);
+            stack.push_back( {child, 0} );
+        }
+    }
+
+    // Divisions in depth-first order
+    std::sort(divisions.begin(), divisions.end(), 
+        [this](int a, int b) { return tourIn[a] < tourIn[b]; });
+}
+
+int LineageGraph::Intern(const string& ID)
+{
+    auto found = ids.find(ID);
+    if (found != ids.end()) {
+        return found->second;
+    }
+    int index = static_cast<int>(nodes.size());
+    nodes.push_back( LineageNode{ID, {}, {}} );
+    ids.insert( {ID, index} );
+    return index;
+}
+
+int LineageGraph::Size() const
+{
+    return nodes.size();
+}
+
+int LineageGraph::NumLinks() const
+{
+    return links.size();
+}
+
+int LineageGraph::Find(const string& ID) const
+{
+    auto found = ids.find(ID);
+    return (found != ids.end()) ? found->second : -1;
+}
+
+const LineageNode& LineageGraph::Node(int index) const
+{
+    try
+    {
+        return nodes.at(index);
+    }
+    catch(const out_of_range& ex)
+    {
+        ostringstream ss;
+        ss << __FILE__ << ":" << __func__ << "() " << "Node not found. Graph size " << nodes.size() << " with index " << index;
+        throw new std::out_of_range(string(ss.str()));
+    }
+}
+
+bool LineageGraph::IsChainNode(int index) const
+{
+    return (nodes[index].parents.size() == 1) && (nodes[index].children.size() == 1);
+}
+
+vector<vector<string>> LineageGraph::Paths() const
+{
+    vector<vector<string>> paths;
+    for (auto& [parent, child]: links) {
+        // Links leaving a chain node are added when the path reaches them
+        if (IsChainNode(parent)) {
+            continue;
+        }
+        vector<string> path = {nodes[parent].ID, nodes[child].ID};
+        int current = child;
+        while (IsChainNode(current)) {
+            current = nodes[current].children.front();
+            path.push_back(nodes[current].ID);
+        }
+        paths.push_back(path);
+    }
+    return paths;
+}
+
+bool LineageGraph::IsAncestor(int ancestor, int descendant) const
+{
+    if ( (tourIn.at(ancestor) < 0) || (tourIn.at(descendant) < 0) ) {
+        return false;
+    }
+    return (tourIn[ancestor] <= tourIn[descendant]) && (tourOut[descendant] <= tourOut[ancestor]);
+}
+
+vector<int> LineageGraph::Ancestors(int index) const
+{
+    vector<int> ancestors;
+    int current = index;
+    // Nodes reaching a cycle have no root, the chain is bounded by the graph size
+    while ( !Node(current).IsRoot() && (ancestors.size() < nodes.size()) ) {
+        current = nodes[current].parents.front();
+        ancestors.push_back(current);
+    }
+    return ancestors;
+}
+
+vector<int> LineageGraph::Descendants(int index) const
+{
+    if (tourIn.at(index) < 0) {
+        return vector<int>();
+    }
+    return vector<int>(preorder.begin() + tourIn[index] + 1, preorder.begin() + tourOut[index]);
+}
+
+int LineageGraph::Depth(int index) const
+{
+    return depth.at(index);
+}
+
+int LineageGraph::Generation(int index) const
+{
+    return generation.at(index);
+}
+
+const vector<int>& LineageGraph::Divisions() const
+{
+    return divisions;
+}
+
+void LineageGraph::SetTime(int index, int t)
+{
+    times.at(index) = t;
+}
+
+int LineageGraph::Time(int index) const
+{
+    return times.at(index);
+}
@@ -0,0 +1,542 @@
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include "Mesh.h"
+
+using namespace std;
+using namespace BD5;
+
+// Points and spheres are drawn in chunks of nearby entities
+static const int entitiesPerBatch = 256;
+
+static MeshBox EmptyBox()
+{
+    const float inf = numeric_limits<float>::infinity();
+    return {inf, inf, inf, -inf, -inf, -inf};
+}
+
+static void GrowBox(MeshBox& box, const float* xyz, float radius)
+{
+    for (int axis = 0; axis < 3; axis++) {
+        box[axis] = std::min(box[axis], xyz[axis] - radius);
+        box[axis + 3] = std::max(box[axis + 3], xyz[axis] + radius);
+    }
+}
+
+static void GrowBox(MeshBox& box, const MeshBox& other)
+{
+    for (int axis = 0; axis < 3; axis++) {
+        box[axis] = std::min(box[axis], other[axis]);
+        box[axis + 3] = std::max(box[axis + 3], other[axis + 3]);
+    }
+}
+
+// Interleave the 10 lower bits of a value with two zero bits (Morton code of one axis)
+static uint32_t SpreadBits(uint32_t value)
+{
+    value &= 0x3ff;
+    value = (value | (value << 16)) & 0x030000ff;
+    value = (value | (value << 8)) & 0x0300f00f;
+    value = (value | (value << 4)) & 0x030c30c3;
+    value = (value | (value << 2)) & 0x09249249;
+    return value;
+}
+
+// Ear clipping of a polygon given by consecutive x, y, z vertices. Concave outlines are split
+// correctly, the triangles keep the winding of the polygon. Repeated consecutive vertices (and a
+// last vertex equal to the first) are skipped. It gives the unit Newell normal of the polygon, 
+// zero for degenerate polygons, which get no triangles
+static void Triangulate(const float* xyz, uint32_t count, vector<uint32_t>& triangles, float* normal)
+{
+    vector<uint32_t> outline;
+    outline.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        if (outline.empty() || !std::equal(xyz + 3 * i, xyz + 3 * i + 3, xyz + 3 * outline.back())) {
+            outline.push_back(i);
+        }
+    }
+    while ( (outline.size() > 1) && std::equal(xyz + 3 * outline.front(), xyz + 3 * outline.front() + 3, xyz + 3 * outline.back()) ) {
+        outline.pop_back();
+    }
+    int n = outline.size();
+    double newell[3] = {0.0, 0.0, 0.0};
+    for (int i = 0; i < n; i++) {
+        const float* a = xyz + 3 * outline[i];
+        const float* b = xyz + 3 * outline[(i + 1) % n];
+        newell[0] += (double(a[1]) - b[1]) * (double(a[2]) + b[2]);
+        newell[1] += (double(a[2]) - b[2]) * (double(a[0]) + b[0]);
+        newell[2] += (double(a[0]) - b[0]) * (double(a[1]) + b[1]);
+    }
+    double length = std::sqrt(newell[0] * newell[0] + newell[1] * newell[1] + newell[2] * newell[2]);
+    for (int axis = 0; axis < 3; axis++) {
+        normal[axis] = (length > 0.0) ? newell[axis] / length : 0.0f;
+    }
+    if ( (n < 3) || (length == 0.0) ) {
+        return;
+    }
+
+    // The polygon is projected on the plane of the two axes with the smallest normal components,
+    // the sign makes it counterclockwise there
+    int drop = 0;
+    for (int axis = 1; axis < 3; axis++) {
+        if (std::abs(newell[axis]) > std::abs(newell[drop])) {
+            drop = axis;
+        }
+    }
+    int u = (drop + 1) % 3;
+    int v = (drop + 2) % 3;
+    double sign = (newell[drop] > 0.0) ? 1.0 : -1.0;
+    auto cross = [&](int a, int b, int c) {
+        const float* pa = xyz + 3 * outline[a];
+        const float* pb = xyz + 3 * outline[b];
+        const float* pc = xyz + 3 * outline[c];
+        return sign * ((double(pb[u]) - pa[u]) * (double(pc[v]) - pa[v]) - (double(pb[v]) - pa[v]) * (double(pc[u]) - pa[u]));
+    };
+    auto same = [&](int a, int b) { return std::equal(xyz + 3 * outline[a], xyz + 3 * outline[a] + 3, xyz + 3 * outline[b]); };
+
+    vector<int> prev(n), next(n);
+    vector<char> reflex(n);
+    for (int i = 0; i < n; i++) {
+        prev[i] = (i + n - 1) % n;
+        next[i] = (i + 1) % n;
+    }
+    for (int i = 0; i < n; i++) {
+        reflex[i] = cross(prev[i], i, next[i]) <= 0.0;
+    }
+    // An ear is a convex vertex whose triangle has no reflex vertex inside
+    auto isEar = [&](int i) {
+        if (reflex[i]) {
+            return false;
+        }
+        int a = prev[i];
+        int c = next[i];
+        for (int j = next[c]; j != a; j = next[j]) {
+            if (reflex[j] && !same(j, a) && !same(j, i) && !same(j, c) &&
+                (cross(a, i, j) >= 0.0) && (cross(i, c, j) >= 0.0) && (cross(c, a, j) >= 0.0)) {
+                return false;
+            }
+        }
+        return true;
+    };
+    int remaining = n;
+    int i = 0;
+    int misses = 0;
+    while (remaining > 3)
+    {
+        // Self-intersecting outlines can have no ear, a vertex is clipped anyway
+        if (isEar(i) || (misses > remaining)) {
+            int a = prev[i];
+            int c = next[i];
+            triangles.insert(triangles.end(), {outline[a], outline[i], outline[c]});
+            next[a] = c;
+            prev[c] = a;
+            reflex[a] = cross(prev[a], a, c) <= 0.0;
+            reflex[c] = cross(a, c, next[c]) <= 0.0;
+            remaining--;
+            misses = 0;
+            i = a;
+        }
+        else {
+            i = next[i];
+            misses++;
+        }
+    }
+    triangles.insert(triangles.end(), {outline[prev[i]], outline[i], outline[next[i]]});
+}
+
+SnapshotMesh::SnapshotMesh(const Snapshot& snapshot, const ScaleUnit& scales, const LabelDictionary& dictionary)
+{
+    switch (scales.Type())
+    {
+        case SpaceTime_t::TwoDimension:
+        case SpaceTime_t::TwoDimensionAndTime:
+            zScale = 0.0;
+            break;
+        case SpaceTime_t::ThreeDimension:
+        case SpaceTime_t::ThreeDimensionAndTime:
+            zScale = scales.ZScale();
+            break;
+        default:
+            // Nothing is drawn without space dimensions
+            return;
+    }
+    xScale = scales.XScale();
+    yScale = scales.YScale();
+    labels = &dictionary;
+
+    auto& objects = snapshot.GetObjects();
+    for (size_t objIndex = 0; objIndex < objects.size(); objIndex++)
+    {
+        auto& object = objects[objIndex];
+        for (int subIndex = 0; subIndex < object.GetNumSubObjects(); subIndex++)
+        {
+            MeshRange range;
+            range.object = objIndex;
+            range.subObject = subIndex;
+            range.type = object.EntityTypeAtSubObject(subIndex);
+            range.firstVertex = NumVertices();
+            range.firstIndex = indices.size();
+            range.firstInstance = NumInstances();
+            range.firstBatch = batches.size();
+            switch (range.type)
+            {
+            case EntityType::Point:
+                if (object.IsQuantizedSubObject(subIndex))
+                {
+                    auto& entities = object.GetQuantizedSubObject(subIndex);
+                    for (size_t i = 0; i < entities.Size(); i++) {
+                        AddVertex(entities.X(i), entities.Y(i), entities.Z(i), entities.Label(i), i);
+                    }
+                }
+                else if (!object.GetSubObject(subIndex).empty())
+                {
+                    auto& entities = object.GetSubObject(subIndex).front();
+                    for (size_t i = 0; i < entities.size(); i++) {
+                        auto& entity = entities[i];
+                        AddVertex(entity.X(), entity.Y(), (zScale != 0.0) ? entity.Z() : 0.0f, entity.Label, i);
+                    }
+                }
+                break;
+            case EntityType::Line:
+            case EntityType::Face:
+                // Every sID group is a line strip split in segments or a polygon triangulated by ear 
+                // clipping. Vertices are shared by the segments or triangles of their group
+                for (size_t group = 0; group < object.GetSubObject(subIndex).size(); group++)
+                {
+                    auto& entities = object.GetSubObject(subIndex)[group];
+                    uint32_t first = NumVertices();
+                    MeshBatch batch;
+                    batch.first = indices.size();
+                    batch.group = group;
+                    batch.box = EmptyBox();
+                    for (size_t i = 0; i < entities.size(); i++) {
+                        auto& entity = entities[i];
+                        AddVertex(entity.X(), entity.Y(), (zScale != 0.0) ? entity.Z() : 0.0f, entity.Label, i);
+                        GrowBox(batch.box, &positions[positions.size() - 3], 0.0f);
+                    }
+                    uint32_t count = entities.size();
+                    if (range.type == EntityType::Line) {
+                        for (uint32_t i = 1; i < count; i++) {
+                            indices.insert(indices.end(), {first + i - 1, first + i});
+                        }
+                    }
+                    else {
+                        float normal[3];
+                        size_t start = indices.size();
+                        Triangulate(&positions[3 * first], count, indices, normal);
+                        for (size_t i = start; i < indices.size(); i++) {
+                            indices[i] += first;
+                        }
+                        for (uint32_t i = first; i < first + count; i++) {
+                            for (int axis = 0; axis < 3; axis++) {
+                                normals[4 * i + axis] = static_cast<int8_t>(std::lround(127.0f * normal[axis]));
+                            }
+                        }
+                    }
+                    batch.count = indices.size() - batch.first;
+                    batch.firstVertex = first;
+                    batch.numVertices = count;
+                    if (batch.count > 0) {
+                        batches.push_back(batch);
+                    }
+                }
+                break;
+            case EntityType::Sphere:
+                if (object.IsQuantizedSubObject(subIndex))
+                {
+                    auto& entities = object.GetQuantizedSubObject(subIndex);
+                    for (size_t i = 0; i < entities.Size(); i++) {
+                        AddInstance(entities.X(i), entities.Y(i), entities.Z(i), entities.Radius(i), entities.Label(i), i);
+                    }
+                }
+                else if (!object.GetSubObject(subIndex).empty())
+                {
+                    auto& entities = object.GetSubObject(subIndex).front();
+                    for (size_t i = 0; i < entities.size(); i++) {
+                        auto& entity = entities[i];
+                        AddInstance(entity.X(), entity.Y(), (zScale != 0.0) ? entity.Z() : 0.0f, entity.Radius(), entity.Label, i);
+                    }
+                }
+                break;
+            default:
+                // Circles are not drawn
+                continue;
+            }
+            range.numVertices = NumVertices() - range.firstVertex;
+            range.numIndices = indices.size() - range.firstIndex;
+            range.numInstances = NumInstances() - range.firstInstance;
+            if ( (range.type == EntityType::Point) || (range.type == EntityType::Sphere) ) {
+                SortSpatially(range);
+                AddBatches(range, entitiesPerBatch);
+            }
+            range.numBatches = batches.size() - range.firstBatch;
+            range.box = EmptyBox();
+            for (int i = range.firstBatch; i < range.firstBatch + range.numBatches; i++) {
+                GrowBox(range.box, batches[i].box);
+            }
+            ranges.push_back(range);
+        }
+    }
+    labels = nullptr;
+}
+
+void SnapshotMesh::AddVertex(float x, float y, float z, const string& label, int entity)
+{
+    positions.insert(positions.end(), {xScale * x, yScale * y, zScale * z});
+    normals.insert(normals.end(), {0, 0, 0, 0});
+    labelIds.push_back(LabelId(label));
+    entities.push_back(entity);
+}
+
+void SnapshotMesh::AddInstance(float x, float y, float z, float radius, const string& label, int entity)
+{
+    instances.insert(instances.end(), {xScale * x, yScale * y, zScale * z, radius});
+    instanceLabelIds.push_back(LabelId(label));
+    instanceEntities.push_back(entity);
+}
+
+int SnapshotMesh::LabelId(const string& label)
+{
+    if (label != lastLabel) {
+        lastLabel = label;
+        lastLabelId = label.empty() ? -1 : labels->Find(label);
+    }
+    return lastLabelId;
+}
+
+void SnapshotMesh::SortSpatially(MeshRange& range)
+{
+    // Entities of Point and Sphere subobjects have no order, they are sorted by the Morton code 
+    // of their position so consecutive entities are close and the batches are small. Their
+    // normals are zero, they are not reordered
+    bool spheres = (range.type == EntityType::Sphere);
+    int first = spheres ? range.firstInstance : range.firstVertex;
+    int count = spheres ? range.numInstances : range.numVertices;
+    int stride = spheres ? 4 : 3;
+    auto& coordinates = spheres ? instances : positions;
+    auto& ids = spheres ? instanceLabelIds : labelIds;
+    auto& indexes = spheres ? instanceEntities : entities;
+    if (count < 2) {
+        return;
+    }
+
+    MeshBox box = EmptyBox();
+    for (int i = first; i < first + count; i++) {
+        GrowBox(box, &coordinates[stride * i], 0.0f);
+    }
+    vector<pair<uint32_t, int>> codes;
+    codes.reserve(count);
+    for (int i = first; i < first + count; i++) {
+        uint32_t code = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            float extent = box[axis + 3] - box[axis];
+            float position = (extent > 0.0f) ? (coordinates[stride * i + axis] - box[axis]) / extent : 0.0f;
+            code |= SpreadBits(static_cast<uint32_t>(position * 1023.0f)) << axis;
+        }
+        codes.push_back( {code, i} );
+    }
+    std::sort(codes.begin(), codes.end());
+
+    vector<float> sortedCoordinates;
+    vector<int> sortedIds;
+    vector<int> sortedIndexes;
+    sortedCoordinates.reserve(stride * count);
+    sortedIds.reserve(count);
+    sortedIndexes.reserve(count);
+    for (auto& [code, i]: codes) {
+        sortedCoordinates.insert(sortedCoordinates.end(), &coordinates[stride * i], &coordinates[stride * (i + 1)]);
+        sortedIds.push_back(ids[i]);
+        sortedIndexes.push_back(indexes[i]);
+    }
+    std::copy(sortedCoordinates.begin(), sortedCoordinates.end(), coordinates.begin() + stride * first);
+    std::copy(sortedIds.begin(), sortedIds.end(), ids.begin() + first);
+    std::copy(sortedIndexes.begin(), sortedIndexes.end(), indexes.begin() + first);
+}
+
+void SnapshotMesh::AddBatches(MeshRange& range, int batchSize)
+{
+    bool spheres = (range.type == EntityType::Sphere);
+    int first = spheres ? range.firstInstance : range.firstVertex;
+    int count = spheres ? range.numInstances : range.numVertices;
+    for (int start = first; start < first + count; start += batchSize) {
+        MeshBatch batch;
+        batch.first = start;
+        batch.count = std::min(batchSize, first + count - start);
+        batch.box = EmptyBox();
+        for (int i = start; i < start + batch.count; i++) {
+            if (spheres) {
+                GrowBox(batch.box, &instances[4 * i], instances[4 * i + 3]);
+            }
+            else {
+                GrowBox(batch.box, &positions[3 * i], 0.0f);
+            }
+        }
+        batches.push_back(batch);
+    }
+}
+
+void SnapshotMesh::Cull(const MeshRange& range, const Frustum& frustum, vector<int>& first, vector<int>& count) const
+{
+    first.clear();
+    count.clear();
+    auto side = frustum.Test(range.box);
+    if (side == Frustum::Side::Outside) {
+        return;
+    }
+    if (side == Frustum::Side::Inside) {
+        switch (range.type)
+        {
+        case EntityType::Point:
+            first.push_back(range.firstVertex);
+            count.push_back(range.numVertices);
+            break;
+        case EntityType::Sphere:
+            first.push_back(range.firstInstance);
+            count.push_back(range.numInstances);
+            break;
+        default:
+            first.push_back(range.firstIndex);
+            count.push_back(range.numIndices);
+            break;
+        }
+        return;
+    }
+    for (int i = range.firstBatch; i < range.firstBatch + range.numBatches; i++) {
+        auto& batch = batches[i];
+        if (frustum.Test(batch.box) == Frustum::Side::Outside) {
+            continue;
+        }
+        AddRun(batch, first, count);
+    }
+}
+
+void SnapshotMesh::Runs(const MeshRange& range, const vector<int>& visibleBatches, vector<int>& first, vector<int>& count) const
+{
+    first.clear();
+    count.clear();
+    auto it = std::lower_bound(visibleBatches.begin(), visibleBatches.end(), range.firstBatch);
+    for (; (it != visibleBatches.end()) && (*it < range.firstBatch + range.numBatches); ++it) {
+        AddRun(batches[*it], first, count);
+    }
+}
+
+void SnapshotMesh::AddRun(const MeshBatch& batch, vector<int>& first, vector<int>& count) const
+{
+    if (!first.empty() && (first.back() + count.back() == batch.first)) {
+        count.back() += batch.count;
+    }
+    else {
+        first.push_back(batch.first);
+        count.push_back(batch.count);
+    }
+}
+
+size_t SnapshotMesh::NumVertices() const
+{
+    return labelIds.size();
+}
+
+size_t SnapshotMesh::NumInstances() const
+{
+    return instanceLabelIds.size();
+}
+
+const vector<float>& SnapshotMesh::Positions() const
+{
+    return positions;
+}
+
+const vector<int8_t>& SnapshotMesh::Normals() const
+{
+    return normals;
+}
+
+const vector<int>& SnapshotMesh::LabelIds() const
+{
+    return labelIds;
+}
+
+const vector<uint32_t>& SnapshotMesh::Indices() const
+{
+    return indices;
+}
+
+const vector<float>& SnapshotMesh::Instances() const
+{
+    return instances;
+}
+
+const vector<int>& SnapshotMesh::InstanceLabelIds() const
+{
+    return instanceLabelIds;
+}
+
+const vector<MeshRange>& SnapshotMesh::Ranges() const
+{
+    return ranges;
+}
+
+const vector<MeshBatch>& SnapshotMesh::Batches() const
+{
+    return batches;
+}
+
+const vector<int>& SnapshotMesh::VertexEntities() const
+{
+    return entities;
+}
+
+const vector<int>& SnapshotMesh::InstanceEntities() const
+{
+    return instanceEntities;
+}
+
+int SnapshotMesh::RangeOfBatch(int batch) const
+{
+    // Ranges are ordered by their first batch, the owner is the last one starting at or before the batch
+    auto it = std::upper_bound(ranges.begin(), ranges.end(), batch,
+        [](int value, const MeshRange& range) { return value < range.firstBatch; });
+    return static_cast<int>(it - ranges.begin()) - 1;
+}
+
+Frustum::Frustum(const float* projection, const float* modelview)
+{
+    // Rows of projection * modelview, the matrices are stored by columns
+    float rows[4][4];
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            rows[i][j] = 0.0f;
+            for (int k = 0; k < 4; k++) {
+                rows[i][j] += projection[4 * k + i] * modelview[4 * j + k];
+            }
+        }
+    }
+    // A point is inside when -w <= x, y, z <= w in clip coordinates
+    for (int axis = 0; axis < 3; axis++) {
+        for (int j = 0; j < 4; j++) {
+            planes[2 * axis][j] = rows[3][j] + rows[axis][j];
+            planes[2 * axis + 1][j] = rows[3][j] - rows[axis][j];
+        }
+    }
+}
+
+Frustum::Side Frustum::Test(const MeshBox& box) const
+{
+    Side side = Side::Inside;
+    for (auto& plane: planes) {
+        // Corners of the box farthest along and against the plane normal
+        float farthest = plane[3];
+        float nearest = plane[3];
+        for (int axis = 0; axis < 3; axis++) {
+            farthest += plane[axis] * ((plane[axis] > 0.0f) ? box[axis + 3] : box[axis]);
+            nearest += plane[axis] * ((plane[axis] > 0.0f) ? box[axis] : box[axis + 3]);
+        }
+        if (farthest < 0.0f) {
+            return Side::Outside;
+        }
+        if (nearest < 0.0f) {
+            side = Side::Intersects;
+        }
+    }
+    return side;
+}
@@ -1,8 +1,56 @@
+#include <cmath>
 #include "Object.h"
 
 using namespace std;
 using namespace BD5;
 
+void Boundaries::updateBoundaries(const Boundaries& newBoundaries)
+{
+    if (newBoundaries.minX < minX) {
+        minX = newBoundaries.minX;
+    }
+    if (newBoundaries.maxX > maxX) {
+        maxX = newBoundaries.maxX;
+    }
+    if (newBoundaries.minY < minY) {
+        minY = newBoundaries.minY;
+    }
+    if (newBoundaries.maxY > maxY) {
+        maxY = newBoundaries.maxY;
+    }
+    if (newBoundaries.minZ < minZ) {
+        minZ = newBoundaries.minZ;
+    }
+    if (newBoundaries.maxZ > maxZ) {
+        maxZ = newBoundaries.maxZ;
+    }
+}
+
+void Boundaries::updateBoundaries(float x, float y, float z)
+{
+    if (x < minX) minX = x;
+    if (x > maxX) maxX = x;
+    if (y < minY) minY = y;
+    if (y > maxY) maxY = y;
+    if (z < minZ) minZ = z;
+    if (z > maxZ) maxZ = z;
+}
+
+float Boundaries::centerX() const
+{
+    return minX + (maxX - minX) / 2;
+}
+
+float Boundaries::centerY() const
+{
+    return minY + (maxY - minY) / 2;
+}
+
+float Boundaries::centerZ() const
+{
+    return minZ + (maxZ - minZ) / 2;
+}
+
 bool EntityData::Is2D() const
 {
     int XYZ = Values.count('x') + Values.count('y') + Values.count('z');
@@ -102,11 +150,172 @@ EntityType EntityData::GetEntityType(const std::string& text)
 }
 
 
+static const float QUANTIZATION_LEVELS = 65535.0f;
+
+static std::uint16_t QuantizeValue(float value, float min, float max)
+{
+    if (max <= min) {
+        return 0;
+    }
+    return static_cast<std::uint16_t>( std::lround( (value - min) / (max - min) * QUANTIZATION_LEVELS ) );
+}
+
+QuantizedEntities QuantizedEntities::Quantize(const vector<EntityData>& entities, const shared_ptr<IDDictionary>& IDs)
+{
+    QuantizedEntities result;
+    if (entities.empty()) {
+        return result;
+    }
+    result.IDs = IDs;
+    result.hasZ = entities.front().HasElement('z');
+    result.hasRadius = entities.front().HasRadius();
+
+    // Exact box of the entities (Boundaries default values are not valid for negative coordinates)
+    const auto& first = entities.front();
+    result.box.minX = result.box.maxX = first.X();
+    result.box.minY = result.box.maxY = first.Y();
+    result.box.minZ = result.box.maxZ = result.hasZ ? first.Z() : 0.0f;
+    result.minRadius = result.maxRadius = result.hasRadius ? first.Radius() : 0.0f;
+    for (auto& entity: entities) {
+        result.box.updateBoundaries(entity.X(), entity.Y(), result.hasZ ? entity.Z() : 0.0f);
+        if (result.hasRadius) {
+            result.minRadius = std::min(result.minRadius, entity.Radius());
+            result.maxRadius = std::max(result.maxRadius, entity.Radius());
+        }
+    }
+
+    result.coordinates.reserve(entities.size() * 3);
+    result.IDIndices.reserve(entities.size());
+    result.labelIndices.reserve(entities.size());
+    if (result.hasRadius) {
+        result.radii.reserve(entities.size());
+    }
+    for (auto& entity: entities) {
+        const auto& box = result.box;
+        result.coordinates.push_back( QuantizeValue(entity.X(), box.minX, box.maxX) );
+        result.coordinates.push_back( QuantizeValue(entity.Y(), box.minY, box.maxY) );
+        result.coordinates.push_back( result.hasZ ? QuantizeValue(entity.Z(), box.minZ, box.maxZ) : 0 );
+        if (result.hasRadius) {
+            result.radii.push_back( QuantizeValue(entity.Radius(), result.minRadius, result.maxRadius) );
+        }
+        result.IDIndices.push_back( IDs->Intern(entity.ID) );
+        // Labels are usually repeated on consecutive entities
+        if (result.labels.empty() || (result.labels.back() != entity.Label)) {
+            auto found = std::find(result.labels.begin(), result.labels.end(), entity.Label);
+            if (found == result.labels.end()) {
+                result.labels.push_back(entity.Label);
+                found = result.labels.end() - 1;
+            }
+            result.labelIndices.push_back( std::distance(result.labels.begin(), found) );
+        }
+        else {
+            result.labelIndices.push_back( result.labels.size() - 1 );
+        }
+    }
+    return result;
+}
+
+size_t QuantizedEntities::Size() const
+{
+    return IDIndices.size();
+}
+
+float QuantizedEntities::Dequantize(std::uint16_t value, float min, float max) const
+{
+    return min + value * ((max - min) / QUANTIZATION_LEVELS);
+}
+
+float QuantizedEntities::X(size_t index) const
+{
+    return Dequantize(coordinates[index * 3], box.minX, box.maxX);
+}
+
+float QuantizedEntities::Y(size_t index) const
+{
+    return Dequantize(coordinates[index * 3 + 1], box.minY, box.maxY);
+}
+
+float QuantizedEntities::Z(size_t index) const
+{
+    return Dequantize(coordinates[index * 3 + 2], box.minZ, box.maxZ);
+}
+
+float QuantizedEntities::Radius(size_t index) const
+{
+    if (!hasRadius) {
+        return 0.0f;
+    }
+    return Dequantize(radii[index], minRadius, maxRadius);
+}
+
+const std::string& QuantizedEntities::ID(size_t index) const
+{
+    return IDs->Name(IDIndices[index]);
+}
+
+const std::string& QuantizedEntities::Label(size_t index) const
+{
+    return labels[labelIndices[index]];
+}
+
+bool QuantizedEntities::Is3D() const
+{
+    return hasZ;
+}
+
+bool QuantizedEntities::HasRadius() const
+{
+    return hasRadius;
+}
+
+EntityData QuantizedEntities::Entity(size_t index) const
+{
+    EntityData entity = { ID(index), Label(index), {{'x', X(index)}, {'y', Y(index)}} };
+    if (hasZ) {
+        entity.Values.insert( {'z', Z(index)} );
+    }
+    if (hasRadius) {
+        entity.Values.insert( {'r', Radius(index)} );
+    }
+    return entity;
+}
+
+vector<EntityData> QuantizedEntities::Dequantize() const
+{
+    vector<EntityData> entities;
+    entities.reserve(Size());
+    for (size_t i = 0; i < Size(); i++) {
+        entities.push_back(Entity(i));
+    }
+    return entities;
+}
+
+float QuantizedEntities::MaxError() const
+{
+    float range = std::max( { box.maxX - box.minX, box.maxY - box.minY, box.maxZ - box.minZ, maxRadius - minRadius } );
+    return (range / QUANTIZATION_LEVELS) / 2.0f;
+}
+
+size_t QuantizedEntities::MemoryBytes() const
+{
+    return (coordinates.size() + radii.size()) * sizeof(std::uint16_t) +
+           (IDIndices.size() + labelIndices.size()) * sizeof(std::uint32_t);
+}
+
+
 void Object::InsertObjectData(EntityType type, const vector<vector<EntityData>>& objData)
 {
+    InsertObjectData(type, objData, vector<PolylineData>());
+}
+
+void Object::InsertObjectData(EntityType type, const vector<vector<EntityData>>& objData, const vector<PolylineData>& objPolylines)
+{
+    Detach();
     try
     {
-        data.push_back(make_pair(type, objData));
+        geometry->data.push_back(make_pair(type, objData));
+        geometry->polylines.push_back(objPolylines);
+        geometry->quantized.push_back(QuantizedEntities());
     }
     catch(const bad_alloc& ex)
     {
@@ -119,24 +328,104 @@ void Object::InsertObjectData(EntityType type, const vector<vector<EntityData>>&
 
 const vector< pair<EntityType, vector<vector<EntityData>>>>& Object::GetAllSubObjects() const
 {
-    return data;
+    return geometry->data;
+}
+
+const vector<PolylineData>& Object::GetPolylinesAtSubObject(int index) const
+{
+    try
+    {
+        return geometry->polylines.at(index);
+    }
+    catch(const out_of_range& ex)
+    {
+        ostringstream ss;
+        ss << __FILE__ << ":" << __func__ << "() " << "SubObject not found. SubObject size " << geometry->polylines.size() << " with index " << index;
+        throw new std::out_of_range(string(ss.str()));
+    }
+}
+
+bool Object::SharesGeometryWith(const Object& other) const
+{
+    return (geometry == other.geometry);
+}
+
+void Object::Detach()
+{
+    // Copy on write, the geometry shared with other objects is immutable
+    if (geometry.use_count() > 1) {
+        geometry = make_shared<Geometry>(*geometry);
+    }
 }
 
 int Object::GetNumSubObjects() const 
 {
-    return data.size();
+    return geometry->data.size();
+}
+
+void Object::QuantizeSubObjects(const shared_ptr<IDDictionary>& IDs)
+{
+    Detach();
+    for (size_t i = 0; i < geometry->data.size(); i++) {
+        auto& [type, entities] = geometry->data[i];
+        bool zeroDimension = (type == EntityType::Point) || (type == EntityType::Circle) || (type == EntityType::Sphere);
+        if (!zeroDimension || entities.empty() || entities.front().empty()) {
+            continue;
+        }
+        geometry->quantized[i] = QuantizedEntities::Quantize(entities.front(), IDs);
+        // Release the memory of the entities
+        vector<vector<EntityData>>().swap(entities);
+    }
+}
+
+bool Object::IsQuantizedSubObject(int index) const
+{
+    return (geometry->quantized.at(index).Size() > 0);
+}
+
+const QuantizedEntities& Object::GetQuantizedSubObject(int index) const
+{
+    try
+    {
+        return geometry->quantized.at(index);
+    }
+    catch(const out_of_range& ex)
+    {
+        ostringstream ss;
+        ss << __FILE__ << ":" << __func__ << "() " << "SubObject not found. SubObject size " << geometry->quantized.size() << " with index " << index;
+        throw new std::out_of_range(string(ss.str()));
+    }
+}
+
+float Object::QuantizationError() const
+{
+    float error = 0.0f;
+    for (auto& subObject: geometry->quantized) {
+        if (subObject.Size() > 0) {
+            error = std::max(error, subObject.MaxError());
+        }
+    }
+    return error;
+}
+
+vector<vector<EntityData>> Object::GetSubObjectEntities(int index) const
+{
+    if (IsQuantizedSubObject(index)) {
+        return vector<vector<EntityData>>{ geometry->quantized.at(index).Dequantize() };
+    }
+    return GetSubObject(index);
 }
 
 const vector<vector<EntityData>>& Object::GetSubObject(int index) const
 {
     try
     {
-        return data.at(index).second;
+        return geometry->data.at(index).second;
     }
     catch(const out_of_range& ex)
     {
         ostringstream ss;
-        ss << __FILE__ << ":" << __func__ << "() " << "SubObject not found. SubObject size " << data.size() << " with index " << index;
+        ss << __FILE__ << ":" << __func__ << "() " << "SubObject not found. SubObject size " << geometry->data.size() << " with index " << index;
         throw new std::out_of_range(string(ss.str()));
     }
 }
@@ -145,12 +434,12 @@ EntityType Object::EntityTypeAtSubObject(int index) const
 {
     try
     {
-        return data.at(index).first;
+        return geometry->data.at(index).first;
     }
     catch(const out_of_range& ex)
     {
         ostringstream ss;
-        ss << __FILE__ << ":" << __func__ << "() " << "SubObject not found. SubObject size " << data.size() << " with index " << index;
+        ss << __FILE__ << ":" << __func__ << "() " << "SubObject not found. SubObject size " << geometry->data.size() << " with index " << index;
         throw new std::out_of_range(string(ss.str()));
     }
     
@@ -160,12 +449,12 @@ const vector<EntityData>& Object::GetEntitiesAtSubObjectNoSID(int time) const
 {
     try
     {
-        return data.at(time).second.at(0);
+        return geometry->data.at(time).second.at(0);
     }
     catch(const out_of_range& ex)
     {
         ostringstream ss;
-        ss << __FILE__ << ":" << __func__ << "() " << "SubObject not found. SubObject size " << data.size() << " with index " << time;
+        ss << __FILE__ << ":" << __func__ << "() " << "SubObject not found. SubObject size " << geometry->data.size() << " with index " << time;
         throw new std::out_of_range(string(ss.str()));
     }
 }
@@ -174,12 +463,12 @@ const vector<EntityData>& Object::GetEntitiesAtSubObjectBySID(int time, int sID)
 {
     try
     {
-        return data.at(time).second.at(sID);
+        return geometry->data.at(time).second.at(sID);
     }
     catch(const out_of_range& ex)
     {
         ostringstream ss;
-        ss << __FILE__ << ":" << __func__ << "() " << "SubObject not found. SubObject size " << data.size() << " with index " << time;
+        ss << __FILE__ << ":" << __func__ << "() " << "SubObject not found. SubObject size " << geometry->data.size() << " with index " << time;
         throw new std::out_of_range(string(ss.str()));
     }    
 }
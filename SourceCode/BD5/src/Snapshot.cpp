@@ -34,4 +34,16 @@ const BD5::Object& Snapshot::GetObjectAt(int index) const
     }   
 }
 
-
+void Snapshot::SetObjectAt(int index, const BD5::Object& object)
+{
+    try
+    {
+        objects.at(index) = object;
+    }
+    catch(const out_of_range& ex)
+    {
+        ostringstream ss;
+        ss << __FILE__ << ":" << __func__ << "() " << "Object not found. Objects size " << objects.size() <<  " with index " << index;
+        throw new std::out_of_range(string(ss.str()));
+    }
+}
@@ -0,0 +1,390 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "SpatialIndex.h"
+
+using namespace std;
+using namespace BD5;
+
+// Leaves keep a few batches, they are tested one by one
+static const int batchesPerLeaf = 4;
+
+static bool Overlaps(const MeshBox& a, const MeshBox& b)
+{
+    for (int axis = 0; axis < 3; axis++) {
+        if ( (a[axis] > b[axis + 3]) || (b[axis] > a[axis + 3]) ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool Contains(const MeshBox& box, const float* xyz)
+{
+    for (int axis = 0; axis < 3; axis++) {
+        if ( (xyz[axis] < box[axis]) || (xyz[axis] > box[axis + 3]) ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static float Dot(const float* a, const float* b)
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static float Distance2(const float* a, const float* b)
+{
+    float d[3] = {a[0] - b[0], a[1] - b[1], a[2] - b[2]};
+    return Dot(d, d);
+}
+
+// Entry distance of a ray in a box grown by a margin, infinity when it is missed
+static float RayBox(const MeshBox& box, float margin, const float* origin, const float* direction)
+{
+    float tmin = 0.0f;
+    float tmax = numeric_limits<float>::infinity();
+    for (int axis = 0; axis < 3; axis++) {
+        float low = box[axis] - margin;
+        float high = box[axis + 3] + margin;
+        if (direction[axis] == 0.0f) {
+            if ( (origin[axis] < low) || (origin[axis] > high) ) {
+                return numeric_limits<float>::infinity();
+            }
+            continue;
+        }
+        float t0 = (low - origin[axis]) / direction[axis];
+        float t1 = (high - origin[axis]) / direction[axis];
+        tmin = std::max(tmin, std::min(t0, t1));
+        tmax = std::min(tmax, std::max(t0, t1));
+        if (tmin > tmax) {
+            return numeric_limits<float>::infinity();
+        }
+    }
+    return tmin;
+}
+
+// Distance from the origin to the farthest corner of a box
+static float FarDistance(const MeshBox& box, const float* origin)
+{
+    float d2 = 0.0f;
+    for (int axis = 0; axis < 3; axis++) {
+        float d = std::max(std::abs(box[axis] - origin[axis]), std::abs(box[axis + 3] - origin[axis]));
+        d2 += d * d;
+    }
+    return std::sqrt(d2);
+}
+
+SpatialIndex::SpatialIndex(const vector<MeshBatch>& batches)
+{
+    auto start = chrono::steady_clock::now();
+    boxes.reserve(batches.size());
+    items.reserve(batches.size());
+    for (size_t i = 0; i < batches.size(); i++) {
+        boxes.push_back(batches[i].box);
+        items.push_back(i);
+    }
+    if (!items.empty()) {
+        nodes.reserve(2 * (items.size() / batchesPerLeaf + 1));
+        Build(0, items.size());
+    }
+    buildMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+int SpatialIndex::Build(int first, int count)
+{
+    int index = nodes.size();
+    nodes.emplace_back();
+    Node node;
+    node.first = first;
+    node.count = count;
+    const float inf = numeric_limits<float>::infinity();
+    node.box = {inf, inf, inf, -inf, -inf, -inf};
+    MeshBox centers = node.box;
+    for (int i = first; i < first + count; i++) {
+        auto& box = boxes[items[i]];
+        for (int axis = 0; axis < 3; axis++) {
+            float center = 0.5f * (box[axis] + box[axis + 3]);
+            node.box[axis] = std::min(node.box[axis], box[axis]);
+            node.box[axis + 3] = std::max(node.box[axis + 3], box[axis + 3]);
+            centers[axis] = std::min(centers[axis], center);
+            centers[axis + 3] = std::max(centers[axis + 3], center);
+        }
+    }
+    if (count > batchesPerLeaf)
+    {
+        int axis = 0;
+        for (int i = 1; i < 3; i++) {
+            if (centers[i + 3] - centers[i] > centers[axis + 3] - centers[axis]) {
+                axis = i;
+            }
+        }
+        int half = count / 2;
+        std::nth_element(items.begin() + first, items.begin() + first + half, items.begin() + first + count,
+            [&](int a, int b) { return boxes[a][axis] + boxes[a][axis + 3] < boxes[b][axis] + boxes[b][axis + 3]; });
+        Build(first, half);
+        node.right = Build(first + half, count - half);
+    }
+    nodes[index] = node;
+    return index;
+}
+
+bool SpatialIndex::Empty() const
+{
+    return nodes.empty();
+}
+
+size_t SpatialIndex::NumBatches() const
+{
+    return items.size();
+}
+
+size_t SpatialIndex::NumNodes() const
+{
+    return nodes.size();
+}
+
+size_t SpatialIndex::MemoryBytes() const
+{
+    return nodes.capacity() * sizeof(Node) + items.capacity() * sizeof(int) + boxes.capacity() * sizeof(MeshBox);
+}
+
+double SpatialIndex::BuildMilliseconds() const
+{
+    return buildMilliseconds;
+}
+
+void SpatialIndex::VisibleBatches(const Frustum& frustum, vector<int>& visible) const
+{
+    visible.clear();
+    if (nodes.empty()) {
+        return;
+    }
+    vector<int> stack = {0};
+    while (!stack.empty())
+    {
+        int index = stack.back();
+        auto& node = nodes[index];
+        stack.pop_back();
+        auto side = frustum.Test(node.box);
+        if (side == Frustum::Side::Outside) {
+            continue;
+        }
+        if (side == Frustum::Side::Inside) {
+            visible.insert(visible.end(), items.begin() + node.first, items.begin() + node.first + node.count);
+        }
+        else if (node.right < 0) {
+            for (int i = node.first; i < node.first + node.count; i++) {
+                if (frustum.Test(boxes[items[i]]) != Frustum::Side::Outside) {
+                    visible.push_back(items[i]);
+                }
+            }
+        }
+        else {
+            stack.push_back(node.right);
+            stack.push_back(index + 1);
+        }
+    }
+    std::sort(visible.begin(), visible.end());
+}
+
+void SpatialIndex::InBox(const SnapshotMesh& mesh, const MeshBox& box, vector<MeshHit>& hits) const
+{
+    hits.clear();
+    if (nodes.empty()) {
+        return;
+    }
+    auto& positions = mesh.Positions();
+    auto& instances = mesh.Instances();
+    vector<int> stack = {0};
+    while (!stack.empty())
+    {
+        int index = stack.back();
+        auto& node = nodes[index];
+        stack.pop_back();
+        if (!Overlaps(node.box, box)) {
+            continue;
+        }
+        if (node.right >= 0) {
+            stack.push_back(node.right);
+            stack.push_back(index + 1);
+            continue;
+        }
+        for (int i = node.first; i < node.first + node.count; i++)
+        {
+            int b = items[i];
+            if (!Overlaps(boxes[b], box)) {
+                continue;
+            }
+            auto& batch = mesh.Batches()[b];
+            int range = mesh.RangeOfBatch(b);
+            auto type = mesh.Ranges()[range].type;
+            if (type == EntityType::Sphere) {
+                for (int e = batch.first; e < batch.first + batch.count; e++) {
+                    if (Contains(box, &instances[4 * e])) {
+                        hits.push_back( {range, b, e, 0.0f} );
+                    }
+                }
+                continue;
+            }
+            int first = (type == EntityType::Point) ? batch.first : batch.firstVertex;
+            int count = (type == EntityType::Point) ? batch.count : batch.numVertices;
+            for (int e = first; e < first + count; e++) {
+                if (Contains(box, &positions[3 * e])) {
+                    hits.push_back( {range, b, e, 0.0f} );
+                }
+            }
+        }
+    }
+}
+
+void SpatialIndex::InRadius(const SnapshotMesh& mesh, const float* center, float radius, vector<MeshHit>& hits) const
+{
+    // Elements in the bounding box of the sphere, then the ones too far are removed
+    MeshBox box = {center[0] - radius, center[1] - radius, center[2] - radius, center[0] + radius, center[1] + radius, center[2] + radius};
+    InBox(mesh, box, hits);
+    auto& positions = mesh.Positions();
+    auto& instances = mesh.Instances();
+    auto& ranges = mesh.Ranges();
+    size_t kept = 0;
+    for (auto& hit : hits) {
+        bool spheres = (ranges[hit.range].type == EntityType::Sphere);
+        float d2 = Distance2(spheres ? &instances[4 * hit.element] : &positions[3 * hit.element], center);
+        if (d2 <= radius * radius) {
+            hit.distance = std::sqrt(d2);
+            hits[kept++] = hit;
+        }
+    }
+    hits.resize(kept);
+}
+
+bool SpatialIndex::RayCast(const SnapshotMesh& mesh, const float* origin, const float* direction, float tolerance, MeshHit& hit,
+                           const vector<bool>* ranges) const
+{
+    if (nodes.empty()) {
+        return false;
+    }
+    auto& positions = mesh.Positions();
+    auto& instances = mesh.Instances();
+    auto& indices = mesh.Indices();
+    MeshHit best;
+    auto candidate = [&](int range, int batch, int element, float t) {
+        if ( (t >= 0.0f) && (t < best.distance) ) {
+            best = {range, batch, element, t};
+        }
+    };
+    // Distance from a point to the ray, measured at the point projection t
+    auto rayDistance2 = [&](const float* p, float& t) {
+        float d[3] = {p[0] - origin[0], p[1] - origin[1], p[2] - origin[2]};
+        t = Dot(d, direction);
+        return Dot(d, d) - t * t;
+    };
+    auto margin = [&](const MeshBox& box) { return tolerance * FarDistance(box, origin); };
+
+    vector<int> stack = {0};
+    while (!stack.empty())
+    {
+        int index = stack.back();
+        auto& node = nodes[index];
+        stack.pop_back();
+        if (RayBox(node.box, margin(node.box), origin, direction) >= best.distance) {
+            continue;
+        }
+        if (node.right >= 0) {
+            stack.push_back(node.right);
+            stack.push_back(index + 1);
+            continue;
+        }
+        for (int i = node.first; i < node.first + node.count; i++)
+        {
+            int b = items[i];
+            if (RayBox(boxes[b], margin(boxes[b]), origin, direction) >= best.distance) {
+                continue;
+            }
+            auto& batch = mesh.Batches()[b];
+            int range = mesh.RangeOfBatch(b);
+            if ( (ranges != nullptr) && !(*ranges)[range] ) {
+                continue;
+            }
+            switch (mesh.Ranges()[range].type)
+            {
+            case EntityType::Point:
+                for (int e = batch.first; e < batch.first + batch.count; e++) {
+                    float t;
+                    float d2 = rayDistance2(&positions[3 * e], t);
+                    if (d2 <= tolerance * tolerance * t * t) {
+                        candidate(range, b, e, t);
+                    }
+                }
+                break;
+            case EntityType::Sphere:
+                for (int e = batch.first; e < batch.first + batch.count; e++) {
+                    float t;
+                    float r = instances[4 * e + 3];
+                    float d2 = rayDistance2(&instances[4 * e], t);
+                    if (d2 <= r * r) {
+                        candidate(range, b, e, t - std::sqrt(r * r - d2));
+                    }
+                }
+                break;
+            case EntityType::Line:
+                for (int k = batch.first; k + 1 < batch.first + batch.count; k += 2) {
+                    // Closest points of the ray and the segment a + s (b - a)
+                    const float* a = &positions[3 * indices[k]];
+                    const float* p = &positions[3 * indices[k + 1]];
+                    float u[3] = {p[0] - a[0], p[1] - a[1], p[2] - a[2]};
+                    float w[3] = {a[0] - origin[0], a[1] - origin[1], a[2] - origin[2]};
+                    float uu = Dot(u, u), ud = Dot(u, direction), uw = Dot(u, w), dw = Dot(direction, w);
+                    float denominator = uu - ud * ud;
+                    float s = (denominator > 0.0f) ? (ud * dw - uw) / denominator : 0.0f;
+                    s = std::clamp(s, 0.0f, 1.0f);
+                    float closest[3] = {a[0] + s * u[0], a[1] + s * u[1], a[2] + s * u[2]};
+                    float t;
+                    float d2 = rayDistance2(closest, t);
+                    if (d2 <= tolerance * tolerance * t * t) {
+                        candidate(range, b, indices[(s < 0.5f) ? k : k + 1], t);
+                    }
+                }
+                break;
+            case EntityType::Face:
+                for (int k = batch.first; k + 2 < batch.first + batch.count; k += 3) {
+                    // Möller–Trumbore ray triangle intersection, both sides are hit
+                    const float* v0 = &positions[3 * indices[k]];
+                    const float* v1 = &positions[3 * indices[k + 1]];
+                    const float* v2 = &positions[3 * indices[k + 2]];
+                    float e1[3] = {v1[0] - v0[0], v1[1] - v0[1], v1[2] - v0[2]};
+                    float e2[3] = {v2[0] - v0[0], v2[1] - v0[1], v2[2] - v0[2]};
+                    float p[3] = {direction[1] * e2[2] - direction[2] * e2[1], direction[2] * e2[0] - direction[0] * e2[2], direction[0] * e2[1] - direction[1] * e2[0]};
+                    float determinant = Dot(e1, p);
+                    if (std::abs(determinant) < 1e-12f) {
+                        continue;
+                    }
+                    float s[3] = {origin[0] - v0[0], origin[1] - v0[1], origin[2] - v0[2]};
+                    float u = Dot(s, p) / determinant;
+                    if ( (u < 0.0f) || (u > 1.0f) ) {
+                        continue;
+                    }
+                    float q[3] = {s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0]};
+                    float v = Dot(direction, q) / determinant;
+                    if ( (v < 0.0f) || (u + v > 1.0f) ) {
+                        continue;
+                    }
+                    float t = Dot(e2, q) / determinant;
+                    // Barycentric weights tell the nearest vertex
+                    float w0 = 1.0f - u - v;
+                    int nearest = (w0 >= u && w0 >= v) ? k : ((u >= v) ? k + 1 : k + 2);
+                    candidate(range, b, indices[nearest], t);
+                }
+                break;
+            default:
+                break;
+            }
+        }
+    }
+    if (best.element < 0) {
+        return false;
+    }
+    hit = best;
+    return true;
+}
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <cmath>
+#include "Tracks.h"
+
+using namespace std;
+using namespace BD5;
+
+TrackStore::TrackStore(const vector<vector<PointTrack>>& tracks)
+{
+    size_t numPoints = 0;
+    for (auto& track: tracks) {
+        numPoints += track.size();
+    }
+    coordinates.reserve(3 * numPoints);
+    times.reserve(numPoints);
+    offsets.reserve(tracks.size() + 1);
+
+    vector<const PointTrack*> sorted;
+    for (auto& track: tracks) {
+        sorted.clear();
+        for (auto& point: track) {
+            sorted.push_back(&point);
+        }
+        std::stable_sort(sorted.begin(), sorted.end(), 
+            [](const PointTrack* a, const PointTrack* b) { return a->id < b->id; });
+        for (auto point: sorted) {
+            coordinates.push_back(point->x);
+            coordinates.push_back(point->y);
+            coordinates.push_back(point->z);
+            times.push_back(point->id);
+        }
+        offsets.push_back(times.size());
+    }
+    ComputeBoxes();
+}
+
+void TrackStore::ComputeBoxes()
+{
+    boxes.assign(6 * NumTracks(), 0.0f);
+    for (size_t i = 0; i < NumTracks(); i++) {
+        float* box = &boxes[6 * i];
+        for (int p = offsets[i]; p < offsets[i + 1]; p++) {
+            for (int axis = 0; axis < 3; axis++) {
+                float value = coordinates[3 * p + axis];
+                if ( (p == offsets[i]) || (value < box[axis]) ) {
+                    box[axis] = value;
+                }
+                if ( (p == offsets[i]) || (value > box[3 + axis]) ) {
+                    box[3 + axis] = value;
+                }
+            }
+        }
+    }
+}
+
+void TrackStore::Scale(float xScale, float yScale, float zScale)
+{
+    for (size_t i = 0; i < coordinates.size(); i += 3) {
+        coordinates[i] *= xScale;
+        coordinates[i + 1] *= yScale;
+        coordinates[i + 2] *= zScale;
+    }
+    ComputeBoxes();
+}
+
+size_t TrackStore::NumTracks() const
+{
+    return offsets.size() - 1;
+}
+
+size_t TrackStore::NumPoints() const
+{
+    return times.size();
+}
+
+const float* TrackStore::Coordinates() const
+{
+    return coordinates.data();
+}
+
+const int* TrackStore::Times() const
+{
+    return times.data();
+}
+
+int TrackStore::Offset(size_t track) const
+{
+    return offsets[track];
+}
+
+int TrackStore::Count(size_t track) const
+{
+    return offsets[track + 1] - offsets[track];
+}
+
+int TrackStore::CountAtTime(size_t track, int t) const
+{
+    auto first = times.begin() + offsets[track];
+    auto last = times.begin() + offsets[track + 1];
+    return std::distance(first, std::upper_bound(first, last, t));
+}
+
+int TrackStore::FirstAtTime(size_t track, int t) const
+{
+    auto first = times.begin() + offsets[track];
+    auto last = times.begin() + offsets[track + 1];
+    return std::distance(first, std::lower_bound(first, last, t));
+}
+
+float TrackStore::Extent(size_t track) const
+{
+    const float* box = &boxes[6 * track];
+    float dx = box[3] - box[0];
+    float dy = box[4] - box[1];
+    float dz = box[5] - box[2];
+    return std::sqrt(dx * dx + dy * dy + dz * dz);
+}
+
+std::array<float, 3> TrackStore::Center(size_t track) const
+{
+    const float* box = &boxes[6 * track];
+    return { (box[0] + box[3]) / 2, (box[1] + box[4]) / 2, (box[2] + box[5]) / 2 };
+}
+
+// Distance from the point p to the segment (a, b)
+static float SegmentDistance(const float* p, const float* a, const float* b)
+{
+    float ab[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    float ap[3] = { p[0] - a[0], p[1] - a[1], p[2] - a[2] };
+    float length = ab[0] * ab[0] + ab[1] * ab[1] + ab[2] * ab[2];
+    float u = (length > 0.0f) ? (ap[0] * ab[0] + ap[1] * ab[1] + ap[2] * ab[2]) / length : 0.0f;
+    u = std::clamp(u, 0.0f, 1.0f);
+    float d[3] = { ap[0] - u * ab[0], ap[1] - u * ab[1], ap[2] - u * ab[2] };
+    return std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+}
+
+TrackStore TrackStore::Simplify(float relativeTolerance) const
+{
+    TrackStore simplified;
+    simplified.offsets.reserve(offsets.size());
+    simplified.boxes = boxes;
+
+    vector<char> keep;
+    vector<pair<int, int>> ranges;
+    for (size_t i = 0; i < NumTracks(); i++) {
+        int first = offsets[i];
+        int count = Count(i);
+        float tolerance = relativeTolerance * Extent(i);
+        keep.assign(count, 0);
+        if (count > 0) {
+            keep.front() = 1;
+            keep.back() = 1;
+        }
+        // Iterative Douglas-Peucker on the ranges (a, b) of the track
+        if (count > 2) {
+            ranges.push_back( {0, count - 1} );
+        }
+        while (!ranges.empty()) {
+            auto [a, b] = ranges.back();
+            ranges.pop_back();
+            int farthest = -1;
+            float maxDistance = tolerance;
+            for (int p = a + 1; p < b; p++) {
+                float distance = SegmentDistance(&coordinates[3 * (first + p)],
+                                    &coordinates[3 * (first + a)], &coordinates[3 * (first + b)]);
+                if (distance > maxDistance) {
+                    maxDistance = distance;
+                    farthest = p;
+                }
+            }
+            if (farthest >= 0) {
+                keep[farthest] = 1;
+                ranges.push_back( {a, farthest} );
+                ranges.push_back( {farthest, b} );
+            }
+        }
+        for (int p = 0; p < count; p++) {
+            if (keep[p]) {
+                simplified.coordinates.insert(simplified.coordinates.end(), 
+                    coordinates.begin() + 3 * (first + p), coordinates.begin() + 3 * (first + p + 1));
+                simplified.times.push_back(times[first + p]);
+            }
+        }
+        simplified.offsets.push_back(simplified.times.size());
+    }
+    return simplified;
+}
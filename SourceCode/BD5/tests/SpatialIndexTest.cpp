@@ -0,0 +1,76 @@
+/**
+ * @file    SpatialIndexTest.cpp
+ * @author  Riken. Center for Biosystems Dynamics Research. Laboratory for Developmental Dynamics
+ * @brief   Checks of the region queries of the SpatialIndex on faces. Returns 0 when every
+ *          check passes, the failed checks are printed
+ * @version 0.1
+ * @date    2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <iostream>
+#include <string>
+#include <vector>
+#include "SpatialIndex.h"
+
+using namespace std;
+using namespace BD5;
+
+static int failures = 0;
+
+static void Check(bool condition, const string& name)
+{
+    if (!condition) {
+        cout << "FAILED: " << name << endl;
+        failures++;
+    }
+}
+
+static vector<EntityData> Polygon(const vector<pair<float, float>>& xy)
+{
+    vector<EntityData> entities;
+    for (auto& [x, y] : xy) {
+        EntityData entity;
+        entity.Label = "face";
+        entity.Values = { {'x', x}, {'y', y}, {'z', 0.0f} };
+        entities.push_back(entity);
+    }
+    return entities;
+}
+
+int main()
+{
+    // A unit square and a concave L shaped face far from it, the first triangle of both
+    // starts at their last vertex
+    auto square = Polygon({ {0, 0}, {1, 0}, {1, 1}, {0, 1} });
+    auto shape = Polygon({ {10, 0}, {12, 0}, {12, 1}, {11, 1}, {11, 2}, {10, 2} });
+    Object object;
+    object.InsertObjectData(EntityType::Face, {square, shape});
+    Snapshot snapshot(0, {object});
+    ScaleUnit scales;
+    scales.Set3Dimension("3D+T", 1, 1, 1, "um");
+    LabelDictionary dictionary;
+    dictionary.Intern("face");
+    SnapshotMesh mesh(snapshot, scales, dictionary);
+    SpatialIndex index(mesh.Batches());
+
+    vector<MeshHit> hits;
+    index.InBox(mesh, {-0.5f, -0.5f, -0.5f, 1.5f, 1.5f, 0.5f}, hits);
+    Check(hits.size() == square.size(), "InBox returns every vertex of the square");
+    index.InBox(mesh, {9.5f, -0.5f, -0.5f, 12.5f, 2.5f, 0.5f}, hits);
+    Check(hits.size() == shape.size(), "InBox returns every vertex of the concave face");
+    index.InBox(mesh, {-0.5f, -0.5f, -0.5f, 12.5f, 2.5f, 0.5f}, hits);
+    Check(hits.size() == square.size() + shape.size(), "InBox returns every vertex of both faces");
+    index.InBox(mesh, {10.5f, 0.5f, -0.5f, 11.5f, 1.5f, 0.5f}, hits);
+    Check((hits.size() == 1) && (mesh.VertexEntities()[hits[0].element] == 3), "InBox returns the inner corner of the concave face");
+
+    float center[3] = {0.5f, 0.5f, 0.0f};
+    index.InRadius(mesh, center, 0.75f, hits);
+    Check(hits.size() == square.size(), "InRadius returns every vertex of the square");
+
+    if (failures == 0) {
+        cout << "All checks passed" << endl;
+    }
+    return (failures == 0) ? 0 : 1;
+}
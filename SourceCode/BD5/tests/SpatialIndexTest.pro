@@ -0,0 +1,41 @@
+# Checks of the BD5 library, without Qt. Build with qmake and make, run bin/SpatialIndexTest
+TEMPLATE = app
+CONFIG += console c++17 sdk_no_version_check
+CONFIG -= qt app_bundle
+
+INCLUDEPATH += ../include
+
+HEADERS       = ../include/Mesh.h \
+                ../include/SpatialIndex.h
+SOURCES       = SpatialIndexTest.cpp \
+                ../src/BD5File.cpp \
+                ../src/DataSet.cpp \
+                ../src/Group.cpp \
+                ../src/Object.cpp \
+                ../src/ScaleUnit.cpp \
+                ../src/Snapshot.cpp \
+                ../src/Labels.cpp \
+                ../src/Lineage.cpp \
+                ../src/Tracks.cpp \
+                ../src/Mesh.cpp \
+                ../src/SpatialIndex.cpp \
+                ../src/TypeDescriptor.cpp \
+                ../src/Logger.cpp
+
+DESTDIR=bin
+OBJECTS_DIR=build
+
+macx: {
+    INCLUDEPATH += /usr/local/hdf5/include
+    LIBS += -L/usr/local/hdf5/lib -lhdf5 -lhdf5_cpp
+}
+
+unix:!macx {
+    INCLUDEPATH += /usr/include/hdf5/serial
+    LIBS += -L /usr/lib/x86_64-linux-gnu/hdf5/serial -lhdf5 -lhdf5_cpp
+}
+
+win32 {
+    INCLUDEPATH += "C:\\Program Files\\HDF_Group\\HDF5\\1.12.0\\include"
+    LIBS += "C:\\Program Files\\HDF_Group\\HDF5\\1.12.0\\lib" -lhdf5 -lhdf5_cpp
+}
@@ -5,6 +5,8 @@ DEPENDPATH += src \
               BD5/src
 
 HEADERS       = include/glwidget.h \
+                include/renderer.h \
+                include/exporter.h \
                 include/window.h \
                 include/mainwindow.h \
                 include/utils.h \
@@ -14,10 +16,17 @@ HEADERS       = include/glwidget.h \
                 BD5/include/Object.h \
                 BD5/include/ScaleUnit.h \
                 BD5/include/Snapshot.h \
+                BD5/include/Labels.h \
+                BD5/include/Lineage.h \
+                BD5/include/Tracks.h \
+                BD5/include/Mesh.h \
+                BD5/include/SpatialIndex.h \
                 BD5/include/TypeDescriptor.h \
                 BD5/include/Logger.h \
                 BD5/include/utils.h
 SOURCES       = src/glwidget.cpp \
+                src/renderer.cpp \
+                src/exporter.cpp \
                 src/window.cpp \
                 src/mainwindow.cpp \
                 src/utils.cpp \
@@ -28,12 +37,17 @@ SOURCES       = src/glwidget.cpp \
                 BD5/src/Object.cpp \
                 BD5/src/ScaleUnit.cpp \
                 BD5/src/Snapshot.cpp \
+                BD5/src/Labels.cpp \
+                BD5/src/Lineage.cpp \
+                BD5/src/Tracks.cpp \
+                BD5/src/Mesh.cpp \
+                BD5/src/SpatialIndex.cpp \
                 BD5/src/TypeDescriptor.cpp \
                 BD5/src/Logger.cpp
 
 CONFIG+=sdk_no_version_check
 
-QT += widgets opengl openglwidgets gamepad core gui
+QT += widgets opengl openglwidgets gamepad core gui concurrent
 
 DESTDIR=bin
 OBJECTS_DIR=build
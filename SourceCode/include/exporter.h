@@ -0,0 +1,71 @@
+/**
+ * @file    exporter.h
+ * @author  Riken. Center for Biosystems Dynamics Research. Laboratory for Developmental Dynamics
+ * @brief   Headless export of a range of times of a BD5 file to numbered PNG images. It renders
+ *          with a QOffscreenSurface and a framebuffer object, so it opens no window. The
+ *          offscreen platform plugin takes its OpenGL context from the X server, nodes without
+ *          a display run it in Xvfb (xvfb-run) with Mesa llvmpipe
+ * @version 0.1
+ * @date    2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#include <QString>
+#include <QSize>
+#include <optional>
+#include "BD5File.h"
+#include "renderer.h"
+
+// What and how to export
+struct exportOptions
+{
+    QString input;
+    QString outputDir;
+    // Time indices, last < 0 exports up to the last time
+    int first = 0;
+    int last = -1;
+    QSize size = QSize(1920, 1080);
+    bool axes = false;
+    bool grid = false;
+    bool tracks = false;
+    // Camera rotation in degrees, the y rotation advances by yRotationStep every frame
+    float xRotation = 0.0;
+    float yRotation = 0.0;
+    float yRotationStep = 0.0;
+};
+
+// Data of one time prepared in a worker thread
+struct exportFrame
+{
+    int index = 0;
+    // Only set when the geometry differs from the previous time
+    std::optional<BD5::SnapshotMesh> mesh;
+    std::optional<BD5::SpatialIndex> spatialIndex;
+    scenePalette palette;
+};
+
+class FrameExporter
+{
+public:
+    FrameExporter(const exportOptions&);
+    /**
+     * @brief   Read the file and write one image per time. The next time is prepared and
+     *          the previous images are encoded in worker threads while a time is rendered
+     *
+     * @return int  0 on success, 1 on error
+     */
+    int run();
+private:
+    exportFrame prepareFrame(int index, bool newMesh);
+    bool sameGeometry(int, int) const;
+
+    exportOptions options;
+    BD5File file;
+    std::vector<BD5::Snapshot> snapshots;
+    BD5::ScaleUnit scales;
+    SceneRenderer renderer;
+};
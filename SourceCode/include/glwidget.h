@@ -16,35 +16,57 @@
 #include <QtCore/QDebug>
 #define GL_SILENCE_DEPRECATION
 #include <QOpenGLWidget>
-#include <QOpenGLFunctions>
+#include <QFutureWatcher>
+#include <QElapsedTimer>
 #include <utility>
+#include <memory>
 #include "BD5File.h"
-#if __APPLE__
-#include <GLUT/glut.h>
-#elif _WIN32
-#include <Windows.h>
-#include <gl/GL.h>
-#include <gl/GLU.h>
-#else
-#include <GL/glut.h>
-#endif
+#include "Mesh.h"
+#include "SpatialIndex.h"
+#include "renderer.h"
+#include "utils.h"
 
 
 using namespace BD5;
 using namespace std;
 
-QT_FORWARD_DECLARE_CLASS(QOpenGLShaderProgram)
 QT_FORWARD_DECLARE_CLASS(QColor)
 
 struct renderSnapshot 
 {
     int index = 0;
     BD5::Snapshot snapshot;
+    // Labels present at index organized as: obj_index, (bitset of label ids)
+    vector<LabelSet> labelSets;
     // Labels organized as: obj_index, label_key, color_value
     vector<map<string, vector<float>>> labelsColors;
 };
 
-class GLWidget : public QOpenGLWidget, protected QOpenGLFunctions
+// Tracks built in a background task
+struct tracksBuild
+{
+    int generation = 0;
+    std::vector<std::vector<PointTrack>> tracks;
+    BD5::TrackStore store;
+    // Simplified tracks, one store per tracksLodTolerances value
+    std::vector<BD5::TrackStore> lods;
+};
+
+// Frame prepared in a background task: the snapshot, its mesh and spatial index when the
+// geometry changes and its labels, colors and palette when the labels present change
+struct frameBuild
+{
+    int generation = 0;
+    renderSnapshot frame;
+    bool newMesh = false;
+    BD5::SnapshotMesh mesh;
+    BD5::SpatialIndex index;
+    bool labelsChanged = false;
+    std::vector<std::vector<std::string>> labels;
+    scenePalette palette;
+};
+
+class GLWidget : public QOpenGLWidget
 {
     Q_OBJECT
 
@@ -66,6 +88,11 @@ public slots:
     void setGrid2DFlag(bool);
     void setGrid3DFlag(bool);
     void setTracksFlag(bool);
+    void setTracksTail(int);
+    void setTracksFading(bool);
+    void setSphereMode(SphereMode);
+    void setImpostorsThreshold(int);
+    void setQuantizedStorage(bool);
     void setObjectShowFlag(string, bool);
     void setLabelColor(int, string, std::vector<float>);
     void setLabelsOneColor(std::vector<float>);
@@ -76,8 +103,10 @@ signals:
     void snapshotTime(float);
     void moveToNextTime();
     void moveToPrevTime();
-    void objectsNames(std::vector<std::string>);
+    void objectsNames(std::vector<std::string>, std::vector<bool>);
     void labelsNames(std::vector<std::string>, std::vector<std::vector<std::string>>);
+    void tracksReady(bool);
+    void entityPicked(QString);
 
 protected:
     void initializeGL() override;
@@ -85,47 +114,82 @@ protected:
     void resizeGL(int, int) override;
     void mousePressEvent(QMouseEvent*) override;
     void mouseMoveEvent(QMouseEvent*) override;
+    void mouseReleaseEvent(QMouseEvent*) override;
     void wheelEvent(QWheelEvent*) override;
 
 private:
     void initializeViewer();
     void initializeGamepad(QWidget*);
-    void lockGamepadJoystick(float, std::function<float()>);
-    void lockGamepadButton(std::function<bool()>);
-    void drawAxes();
-    void drawPlaneGrid(pair<char, char>, int, float);
-    void drawGrid2D();
-    void drawGrid3D();
-    int getGridSpacing(BD5::Boundaries);
-    void drawTracks(int);
-    void setCurrentSnapshot(int, BD5::Snapshot&, std::vector<std::vector<std::string>>);
+    void requestFrame();
+    void startTimeRepeat(int);
+    bool inputActive() const;
+    void advanceInput();
+    void animateFrame();
+    void startTracks();
+    void publishTracks();
+    void waitForTracks();
+    void requestSnapshot(int);
+    void startFrame();
+    void publishFrame();
+    void pickEntity(QPoint);
+    QString describeHit(const BD5::MeshHit&);
     void setDefaultPaletteColors(std::vector<std::vector<std::string>>);
-    void defineGLColor(std::string);
+    void updatePalette();
+    void updateObjectsVisibility();
 
     QGamepad *m_gamepad = nullptr;
-    const int linesPerGrid = 10;
-    const int pointSize = 5;
-    bool m_core;
     int m_xRot = 0;
     int m_yRot = 0;
     int m_zRot = 0;
     float cameraZ = 0.0;
     float deltaZ = 0.0;
 
-    bool showAxes = false;
-    bool showGrid2D = false;
-    bool showGrid3D = false;
-    bool showTracks = false;
-    int gridSpacing = 0;
     BD5::Boundaries boundaries;
     QPoint m_lastPos;
+    QPoint m_pressPos;
+    // Mouse and gamepad input is integrated once per painted frame. While there is input the
+    // next frame is requested when the previous one is swapped, so frames follow the display
+    // refresh and nothing runs when the input is idle
+    QElapsedTimer frameClock;
+    QPoint pendingDrag;
+    float xRotationRest = 0.0;
+    float yRotationRest = 0.0;
+    // Full stick rates per second: rotation and zoom in deltaZ units (ten times faster with R1)
+    const float gamepadDeadZone = 0.1;
+    const float gamepadRotationSpeed = 400.0;
+    const float gamepadZoomSpeed = 1000.0;
+    // Time steps while R1 and an arrow are held: 1 forward, -1 backward, 0 none
+    int timeRepeat = 0;
+    QElapsedTimer timeRepeatClock;
+    const int timeRepeatMilliseconds = 100;
     BD5File file;
 
     vector<BD5::Snapshot> snapshots;
     map<string, bool> objsVisibility;
     renderSnapshot currentSnapshot;
+
+    // Drawing of the scene, shared with the offscreen exporter
+    SceneRenderer renderer;
+    // Frames are prepared in the background (the back buffer) and swapped into currentSnapshot
+    // and the renderer when ready, the last completed frame is drawn meanwhile
+    QFutureWatcher<frameBuild> frameWatcher;
+    int frameGeneration = 0;
+    bool framePending = false;
+    // Time to prepare after the current frame, -1 for none
+    int requestedIndex = -1;
+    // Copy of the labels dictionary read by the task
+    std::shared_ptr<const BD5::LabelDictionary> labelsView;
+    // Picking casts a ray with the matrices of the last frame, points and lines are
+    // picked within pickPixels. A press and release closer than clickPixels is a click
+    const int pickPixels = 4;
+    const int clickPixels = 3;
+    std::vector<bool> pickableRanges;
     
-    std::vector<std::vector<PointTrack>> tracks;
+    // Tracks are created after the first frame. A new build discards the previous ones,
+    // they keep running until they finish and are only waited for before the file changes
+    QFutureWatcher<tracksBuild> tracksWatcher;
+    std::vector<QFuture<tracksBuild>> staleTracks;
+    int tracksGeneration = 0;
+    bool tracksPending = false;
     BD5::ScaleUnit scales;
-    GLUquadricObj *qobj;
 };
@@ -11,9 +11,11 @@
 # pragma once
 
 #include <QMainWindow>
+#include "utils.h"
 QT_BEGIN_NAMESPACE
 class QStatusBar;
 class QLabel;
+class QCheckBox;
 QT_END_NAMESPACE
 
 class MainWindow : public QMainWindow
@@ -23,6 +25,9 @@ class MainWindow : public QMainWindow
 public:
     MainWindow();
 
+public slots:
+    void setTracksEnabled(bool);
+
 private slots:
     void onOpenFile();
 
@@ -34,9 +39,16 @@ signals:
     void grid2DChanged(bool);
     void grid3DChanged(bool);
     void tracksChanged(bool);
+    void tracksTailChanged(int);
+    void tracksFadingChanged(bool);
+    void sphereModeChanged(SphereMode);
+    void impostorsThresholdChanged(int);
+    void quantizedStorageChanged(bool);
 private:
     QStatusBar *statusBar;
     QLabel *statusFileName;
+    QCheckBox *tracksCheck;
+    int impostorsThreshold = defaultImpostorsThreshold;
 };
 
 
@@ -0,0 +1,259 @@
+/**
+ * @file    renderer.h
+ * @author  Riken. Center for Biosystems Dynamics Research. Laboratory for Developmental Dynamics
+ * @brief   OpenGL drawing of a BD5 scene (snapshot, spheres, tracks, axes and grids) in the current
+ *          context. It is used by the GLWidget and by the offscreen exporter
+ * @version 0.1
+ * @date    2026-10-18
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+
+#pragma once
+
+#define GL_SILENCE_DEPRECATION
+#include <QOpenGLFunctions>
+#include <QOpenGLBuffer>
+#include <QOpenGLVertexArrayObject>
+#include <map>
+#include <string>
+#include <vector>
+#include <utility>
+#include "BD5File.h"
+#include "Mesh.h"
+#include "SpatialIndex.h"
+#include "utils.h"
+#if __APPLE__
+#include <GLUT/glut.h>
+#elif _WIN32
+#include <Windows.h>
+#include <gl/GL.h>
+#include <gl/GLU.h>
+#else
+#include <GL/glut.h>
+#endif
+
+QT_FORWARD_DECLARE_CLASS(QOpenGLContext)
+QT_FORWARD_DECLARE_CLASS(QOpenGLShaderProgram)
+QT_FORWARD_DECLARE_CLASS(QOpenGLFunctions_2_1)
+QT_FORWARD_DECLARE_CLASS(QOpenGLExtraFunctions)
+
+// Rotations and distance of the camera to the center of the scene
+struct sceneCamera
+{
+    float xRot = 0.0;
+    float yRot = 0.0;
+    float zRot = 0.0;
+    float distance = 0.0;
+};
+
+// Color of every label id in rows of paletteWidth RGBA texels
+struct scenePalette
+{
+    int height = 0;
+    std::vector<GLubyte> texels;
+};
+
+class SceneRenderer : protected QOpenGLFunctions
+{
+public:
+    SceneRenderer();
+    /**
+     * @brief   Create the shaders, textures and buffers. The context must be current
+     *
+     * @param context   Current context
+     */
+    void initialize(QOpenGLContext* context);
+    /**
+     * @brief   Release the OpenGL resources. The context of initialize must be current
+     *
+     */
+    void destroy();
+    /**
+     * @brief   Set the viewport and the projection
+     *
+     * @param width         Width in pixels
+     * @param height        Height in pixels
+     * @param pixelRatio    Device pixels per pixel
+     */
+    void resize(int width, int height, float pixelRatio = 1.0);
+    /**
+     * @brief   Draw the scene at a time index
+     *
+     * @param time      Time index, it sets the visible part of the tracks
+     * @param camera    Camera position
+     */
+    void paint(int time, const sceneCamera& camera);
+
+    /**
+     * @brief   Set the scales and the scaled boundaries of the data. It rebuilds the axes and grids
+     *
+     */
+    void setScene(const BD5::ScaleUnit&, const BD5::Boundaries&);
+    /**
+     * @brief   Camera looking at the whole scene
+     *
+     * @return sceneCamera  Default camera
+     */
+    sceneCamera defaultCamera() const;
+    void setMesh(BD5::SnapshotMesh);
+    const BD5::SnapshotMesh& mesh() const;
+    /**
+     * @brief   Set the spatial index of the current mesh, used for culling until the mesh changes
+     *
+     */
+    void setSpatialIndex(BD5::SpatialIndex);
+    bool hasSpatialIndex() const;
+    const BD5::SpatialIndex& spatialIndex() const;
+    /**
+     * @brief   Build the palette of the label colors. It does not use OpenGL, it can run in any thread
+     *
+     * @param labelsColors  Colors of the labels of every object
+     * @param dictionary    Label ids
+     * @return scenePalette The palette texels. When several objects have a label the last one
+     *                      sets it, labels without color are white
+     */
+    static scenePalette buildPalette(const std::vector<std::map<std::string, std::vector<float>>>& labelsColors,
+                                     const BD5::LabelDictionary& dictionary);
+    void setPalette(scenePalette);
+    void setObjectsVisibility(std::vector<bool>);
+    /**
+     * @brief   Set the tracks and their levels of detail, as fine as tracksLodTolerances
+     *
+     */
+    void setTracks(BD5::TrackStore, std::vector<BD5::TrackStore>);
+    size_t numTracks() const;
+    /**
+     * @brief   Projection and modelview matrices of the last frame, in column-major order
+     *
+     */
+    const GLfloat* lastProjection() const;
+    const GLfloat* lastModelview() const;
+    bool hasPainted() const;
+
+    bool showAxes = false;
+    bool showGrid2D = false;
+    bool showGrid3D = false;
+    bool showTracks = false;
+    // Only the last tracksTail times are drawn (0 draws the full history), optionally faded
+    int tracksTail = 0;
+    bool tracksFading = false;
+    SphereMode sphereMode = SphereMode::Automatic;
+    int impostorsThreshold = defaultImpostorsThreshold;
+    // Douglas-Peucker tolerance of every level relative to the track extent, from fine to coarse
+    const std::vector<float> tracksLodTolerances = {1.0f / 256, 1.0f / 64, 1.0f / 16, 1.0f / 4};
+
+private:
+    void uploadSceneFurniture();
+    void addPlaneGrid(std::vector<float>&, std::pair<char, char>, int, float);
+    void drawAxes();
+    void drawGrid(QOpenGLBuffer&, int);
+    void drawTracks(int);
+    void uploadTracks();
+    void drawSnapshot();
+    bool isObjectVisible(int) const;
+    void cullRange(const BD5::MeshRange&, const BD5::Frustum&);
+    void drawSpheres(const GLfloat*, const GLfloat*);
+    void createSphereGeometry();
+    void uploadSnapshot();
+    void uploadPalette();
+    void bindPalette(QOpenGLShaderProgram*);
+    static int getGridSpacing(BD5::Boundaries);
+
+    const int linesPerGrid = 10;
+    const int pointSize = 5;
+    bool m_core;
+    int viewportHeight = 1;
+    int gridSpacing = 0;
+    BD5::Boundaries boundaries;
+    BD5::ScaleUnit scales;
+    std::vector<bool> objectsVisibility;
+    // Matrices of the last frame, the projection is set by resize and the modelview by paint
+    GLfloat projection[16] = {};
+    GLfloat modelview[16] = {};
+    bool painted = false;
+
+    // Points, lines and faces of the current snapshot are kept in vertex buffers and drawn
+    // with shaders. Vertices keep their label id, the colors are looked up in the palette.
+    // Faces are indexed triangles lit with the normal of their face
+    BD5::SnapshotMesh snapshotMesh;
+    QOpenGLShaderProgram *snapshotProgram = nullptr;
+    QOpenGLVertexArrayObject snapshotVao;
+    QOpenGLBuffer snapshotVertexBuffer;
+    QOpenGLBuffer snapshotLabelBuffer;
+    QOpenGLBuffer snapshotNormalBuffer;
+    QOpenGLBuffer snapshotIndexBuffer = QOpenGLBuffer(QOpenGLBuffer::IndexBuffer);
+    bool snapshotUploaded = false;
+    // Changing a color only updates the palette texture
+    static constexpr int paletteWidth = 1024;
+    scenePalette palette;
+    GLuint paletteTexture = 0;
+    int paletteHeight = 0;
+    bool paletteUploaded = false;
+    int snapshotProjMatrixLoc = 0;
+    int snapshotMvMatrixLoc = 0;
+    int snapshotLitLoc = 0;
+    // Spheres are instances of one unit sphere, drawn with one instanced call per subobject
+    const int sphereSlices = 24;
+    const int sphereStacks = 16;
+    QOpenGLShaderProgram *sphereProgram = nullptr;
+    QOpenGLBuffer sphereVertexBuffer;
+    QOpenGLBuffer sphereIndexBuffer = QOpenGLBuffer(QOpenGLBuffer::IndexBuffer);
+    int sphereNumIndices = 0;
+    QOpenGLBuffer spheresInstanceBuffer;
+    QOpenGLBuffer spheresLabelBuffer;
+    int sphereProjMatrixLoc = 0;
+    int sphereMvMatrixLoc = 0;
+    // Impostors are camera facing quads where the fragment shader ray casts the sphere
+    QOpenGLShaderProgram *impostorProgram = nullptr;
+    QOpenGLBuffer impostorVertexBuffer;
+    int impostorProjMatrixLoc = 0;
+    int impostorMvMatrixLoc = 0;
+    // Runs of visible elements of a subobject and of all the spheres in the current frame
+    std::vector<int> visibleFirst;
+    std::vector<int> visibleCount;
+    std::vector<const void*> visibleIndices;
+    std::vector<int> spheresFirst;
+    std::vector<int> spheresCount;
+    // Instanced drawing needs OpenGL 3.3 or OpenGL ES 3.0, impostors are only drawn instanced
+    QOpenGLExtraFunctions *m_extra = nullptr;
+    // Batches of the mesh in a bounding volume hierarchy. It gives the visible batches of
+    // all the subobjects with one traversal per frame
+    BD5::SpatialIndex index;
+    bool indexReady = false;
+    std::vector<int> visibleBatches;
+
+    // Scaled tracks coordinates and the levels of detail with coarser tracks
+    BD5::TrackStore tracks;
+    std::vector<BD5::TrackStore> tracksLods;
+    // Palette color and time of every point of every level
+    std::vector<std::vector<float>> tracksColors;
+    std::vector<std::vector<float>> tracksTimes;
+    GLuint tracksFadeTexture = 0;
+    // Position of the first point of every level in the vertex buffers
+    std::vector<int> tracksLevelBase;
+    // Tracks are drawn from vertex buffers with one multi-draw call
+    QOpenGLFunctions_2_1 *m_gl21 = nullptr;
+    QOpenGLBuffer tracksVertexBuffer;
+    QOpenGLBuffer tracksColorBuffer;
+    QOpenGLBuffer tracksTimeBuffer;
+    bool tracksUploaded = false;
+    // Level, first point and number of visible points of every track in the current frame
+    std::vector<int> tracksLevel;
+    std::vector<GLint> tracksFirst;
+    std::vector<GLsizei> tracksCount;
+    // Segments joining the window of a coarse level to the true first point and to the true
+    // position at the current time, as x, y, z, r, g, b, time for every vertex
+    std::vector<float> tracksJoints;
+
+    // Axes (lit triangles) and grids (lines) are built in vertex buffers when the bounds
+    // or the grid spacing change and drawn with one call each
+    QOpenGLBuffer axesBuffer;
+    QOpenGLBuffer grid2DBuffer;
+    QOpenGLBuffer grid3DBuffer;
+    int axesNumVertices = 0;
+    int grid2DNumVertices = 0;
+    int grid3DNumVertices = 0;
+    bool furnitureUploaded = false;
+};
@@ -12,8 +12,24 @@
 #pragma once
 
 #include <vector>
+#include <map>
+#include <string>
+
+/**
+ * @brief   How spheres are drawn. Automatic draws impostors above a number of spheres
+ * 
+ */
+enum class SphereMode { Automatic, Meshes, Impostors };
+const int defaultImpostorsThreshold = 100000;
 
 class ColorPalette {
 public:
     std::vector<float> GetColorAt(int);
+    /**
+     * @brief   Colors of the labels of every object, in palette order across the objects
+     * 
+     * @param objLabels     Labels of every object
+     * @return std::vector<std::map<std::string, std::vector<float>>>   Color of every label of every object
+     */
+    std::vector<std::map<std::string, std::vector<float>>> GetLabelsColors(const std::vector<std::vector<std::string>>& objLabels);
 };
@@ -32,7 +32,7 @@ public:
 
 protected:
     void keyPressEvent(QKeyEvent*) override;
-    void createObjsGroupBox(std::vector<std::string>);
+    void createObjsGroupBox(std::vector<std::string>, std::vector<bool>);
     void createLabelsGroupBox(std::vector<std::string>, std::vector<std::vector<std::string>>);
     void removeObjectsNames();
     void removeLabelNames();
@@ -46,9 +46,10 @@ public slots:
     void setTimeToDisplay(float);
     void moveToNextTime();
     void moveToPrevTime();
-    void setObjectsNames(std::vector<std::string>);
+    void setObjectsNames(std::vector<std::string>, std::vector<bool>);
     void setLabelsNames(std::vector<std::string>, std::vector<std::vector<std::string>>);
     void oneColorStateChanged(bool);
+    void setPickedEntity(QString);
 
 signals:
     void showObjectCheckChanged(std::string, bool);
@@ -67,6 +68,7 @@ private:
     QLabel *maxTLabel;
     QLabel *indexTLabel;
     QLabel *timeLabel;
+    QLabel *pickedLabel;
     QVBoxLayout* objsAndLabels;
     QVBoxLayout *labelsLayout;
     QVBoxLayout *oneColorLayout;
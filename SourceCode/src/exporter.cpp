@@ -0,0 +1,172 @@
+#include <QOpenGLContext>
+#include <QOffscreenSurface>
+#include <QOpenGLFramebufferObject>
+#include <QImage>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrent>
+#include <deque>
+#include <algorithm>
+#include <sstream>
+#include "exporter.h"
+#include "utils.h"
+
+using namespace BD5;
+using namespace std;
+
+FrameExporter::FrameExporter(const exportOptions& exportOptions) : options(exportOptions)
+{
+}
+
+int FrameExporter::run()
+{
+    Boundaries boundaries;
+    try
+    {
+        snapshots = file.Read(options.input.toStdString());
+        scales = file.Scales();
+        boundaries = file.GetBoundaries();
+        boundaries.maxX = boundaries.maxX * scales.XScale();
+        boundaries.maxY = boundaries.maxY * scales.YScale();
+        boundaries.maxZ = boundaries.maxZ * scales.ZScale();
+        boundaries.minX = boundaries.minX * scales.XScale();
+        boundaries.minY = boundaries.minY * scales.YScale();
+        boundaries.minZ = boundaries.minZ * scales.ZScale();
+    }
+    catch (const std::exception& e) {
+        cout << "Error at reading file " << options.input.toStdString() << endl;
+        cout << e.what() << endl;
+        return 1;
+    }
+    if (snapshots.empty()) {
+        cout << "Export. The file has no snapshots" << endl;
+        return 1;
+    }
+    int first = std::clamp(options.first, 0, static_cast<int>(snapshots.size()) - 1);
+    int last = (options.last < 0) ? static_cast<int>(snapshots.size()) - 1 : std::clamp(options.last, first, static_cast<int>(snapshots.size()) - 1);
+    if (!QDir().mkpath(options.outputDir)) {
+        cout << "Export. Can not create the directory " << options.outputDir.toStdString() << endl;
+        return 1;
+    }
+
+    QOffscreenSurface surface;
+    surface.setFormat(QSurfaceFormat::defaultFormat());
+    surface.create();
+    QOpenGLContext context;
+    context.setFormat(surface.format());
+    if (!context.create() || !context.makeCurrent(&surface)) {
+        cout << "Export. Error at creating the OpenGL context, without a display run it with xvfb-run -a" << endl;
+        return 1;
+    }
+    QOpenGLFramebufferObjectFormat fboFormat;
+    fboFormat.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+    QOpenGLFramebufferObject fbo(options.size, fboFormat);
+    if (!fbo.isValid()) {
+        cout << "Export. Error at creating the framebuffer" << endl;
+        return 1;
+    }
+
+    renderer.initialize(&context);
+    renderer.setScene(scales, boundaries);
+    vector<bool> visibility;
+    for (auto& obj : file.ObjectsNames()) {
+        visibility.push_back(file.IsObjectVisible(obj));
+    }
+    renderer.setObjectsVisibility(visibility);
+    renderer.showAxes = options.axes;
+    bool is3D = (scales.Type() == SpaceTime_t::ThreeDimension) || (scales.Type() == SpaceTime_t::ThreeDimensionAndTime);
+    renderer.showGrid2D = options.grid && !is3D;
+    renderer.showGrid3D = options.grid && is3D;
+    if (options.tracks && file.HasTracks()) {
+        auto tracks = file.CreateTracks(snapshots);
+        file.SetTracks(tracks);
+        TrackStore store(tracks);
+        store.Scale(scales.XScale(), scales.YScale(), scales.ZScale());
+        vector<TrackStore> lods;
+        for (auto tolerance: renderer.tracksLodTolerances) {
+            lods.push_back(store.Simplify(tolerance));
+        }
+        renderer.setTracks(std::move(store), std::move(lods));
+        renderer.showTracks = true;
+    }
+    sceneCamera camera = renderer.defaultCamera();
+    camera.xRot = options.xRotation;
+
+    QElapsedTimer timer;
+    timer.start();
+    // Up to one time is prepared and a few images are encoded while a time is rendered
+    const size_t maxSaves = std::max(2, QThreadPool::globalInstance()->maxThreadCount());
+    deque<QFuture<bool>> saves;
+    bool saved = true;
+    QFuture<exportFrame> next = QtConcurrent::run([this, first]() { return prepareFrame(first, true); });
+    for (int t = first; t <= last; t++)
+    {
+        exportFrame frame = next.result();
+        if (t < last) {
+            bool newMesh = !sameGeometry(t, t + 1);
+            next = QtConcurrent::run([this, t, newMesh]() { return prepareFrame(t + 1, newMesh); });
+        }
+        if (frame.mesh) {
+            renderer.setMesh(std::move(*frame.mesh));
+            renderer.setSpatialIndex(std::move(*frame.spatialIndex));
+            auto& index = renderer.spatialIndex();
+            std::ostringstream ss;
+            ss << __FILE__ << ":" << __func__ << "() " << "Spatial index at time " << t << " " << index.NumBatches() << " batches "
+               << index.NumNodes() << " nodes " << index.MemoryBytes() / 1024 << " KiB built in " << index.BuildMilliseconds() << " ms";
+            file.LogInfo(ss.str());
+        }
+        renderer.setPalette(std::move(frame.palette));
+
+        camera.yRot = options.yRotation + options.yRotationStep * (t - first);
+        fbo.bind();
+        renderer.resize(options.size.width(), options.size.height());
+        renderer.paint(t, camera);
+        fbo.release();
+        QImage image = fbo.toImage();
+
+        while (saves.size() >= maxSaves) {
+            saved = saves.front().result() && saved;
+            saves.pop_front();
+        }
+        QString path = QDir(options.outputDir).filePath(QString("frame_%1.png").arg(t, 5, 10, QChar('0')));
+        saves.push_back( QtConcurrent::run([image, path]() { return image.save(path, "PNG"); }) );
+    }
+    for (auto& save : saves) {
+        saved = save.result() && saved;
+    }
+    renderer.destroy();
+    context.doneCurrent();
+
+    cout << "Exported " << (last - first + 1) << " frames to " << options.outputDir.toStdString() << " in "
+         << timer.elapsed() / 1000.0 << " s" << endl;
+    if (!saved) {
+        cout << "Export. Error at writing some images" << endl;
+        return 1;
+    }
+    return 0;
+}
+
+exportFrame FrameExporter::prepareFrame(int index, bool newMesh)
+{
+    // Runs in a worker thread while the main thread renders, it only reads the file
+    exportFrame frame;
+    frame.index = index;
+    if (newMesh) {
+        frame.mesh = SnapshotMesh(snapshots[index], scales, file.GetLabelDictionary());
+        frame.spatialIndex = SpatialIndex(frame.mesh->Batches());
+    }
+    ColorPalette palette;
+    auto labelsColors = palette.GetLabelsColors(file.GetLabelsAtTime(index));
+    frame.palette = SceneRenderer::buildPalette(labelsColors, file.GetLabelDictionary());
+    return frame;
+}
+
+bool FrameExporter::sameGeometry(int a, int b) const
+{
+    auto& objectsA = snapshots[a].GetObjects();
+    auto& objectsB = snapshots[b].GetObjects();
+    return (objectsA.size() == objectsB.size()) &&
+        std::equal(objectsA.begin(), objectsA.end(), objectsB.begin(),
+            [](const Object& x, const Object& y) { return x.SharesGeometryWith(y); });
+}
@@ -3,7 +3,13 @@
 #include <QColor>
 #include <QEventLoop>
 #include <QTimer>
+#include <QElapsedTimer>
+#include <QMatrix4x4>
+#include <QVector4D>
+#include <QtConcurrent/QtConcurrent>
 #include <math.h>
+#include <algorithm>
+#include <sstream>
 #include "glwidget.h"
 #include "BD5File.h"
 #include "utils.h"
@@ -11,7 +17,6 @@
 GLWidget::GLWidget(QWidget *parent) : 
     QOpenGLWidget(parent)
 {
-    m_core = QSurfaceFormat::defaultFormat().profile() == QSurfaceFormat::CoreProfile;
     QList<int> gamepads = QGamepadManager::instance()->connectedGamepads();
     if (!gamepads.isEmpty()) {
         qDebug() << "Gamepad detected ";
@@ -20,11 +25,19 @@ GLWidget::GLWidget(QWidget *parent) :
     } else {
         qDebug() << "No gamepads detected ";
     }
+    connect(&tracksWatcher, &QFutureWatcher<tracksBuild>::finished, this, &GLWidget::publishTracks);
+    connect(&frameWatcher, &QFutureWatcher<frameBuild>::finished, this, &GLWidget::publishFrame);
+    connect(this, &QOpenGLWidget::frameSwapped, this, &GLWidget::animateFrame);
 }
 
 GLWidget::~GLWidget()
 {
-    gluDeleteQuadric(qobj);
+    // The background tasks use the BD5File
+    waitForTracks();
+    frameWatcher.waitForFinished();
+    makeCurrent();
+    renderer.destroy();
+    doneCurrent();
     if (m_gamepad != nullptr) {
         delete m_gamepad;
     }
@@ -57,17 +70,7 @@ void GLWidget::setTimeToVisualize(int time)
         return;
     try
     {
-        emit snapshotTime( snapshots[time].Time() * scales.TScale() );
-        auto names = file.GetLabelsAtTime(time);
-        // for (auto &obj: names) {
-        //     for (auto &name: obj) {
-        //         cout << "TimeToVisualize " << time << " " << name << " ";
-        //     }
-        // }
-        // cout << endl;
-        setCurrentSnapshot(time, snapshots[time], names);
-
-        update();
+        requestSnapshot(time);
     }
     catch(const std::exception& e)
     {
@@ -104,7 +107,19 @@ void GLWidget::setZRotation(int angle)
 
 void GLWidget::setGeometry(QString filePath)
 {
+    // Read can not run while the tracks of the previous file are created
+    waitForTracks();
+    tracksGeneration++;
+    renderer.setTracks(BD5::TrackStore(), vector<BD5::TrackStore>());
+    emit tracksReady(false);
+
     snapshots.clear();
+    // A frame being prepared for the previous file is discarded
+    frameGeneration++;
+    requestedIndex = -1;
+    labelsView.reset();
+    currentSnapshot = renderSnapshot();
+    renderer.setMesh(BD5::SnapshotMesh());
     try
     {
         snapshots = file.Read(filePath.toStdString());
@@ -117,10 +132,8 @@ void GLWidget::setGeometry(QString filePath)
         boundaries.minX = boundaries.minX * scales.XScale();        
         boundaries.minY = boundaries.minY * scales.YScale();        
         boundaries.minZ = boundaries.minZ * scales.ZScale();
-        gridSpacing = getGridSpacing(boundaries);
-        if (file.HasTracks()) {
-            tracks = file.GetTracks();
-        }
+        renderer.setScene(scales, boundaries);
+        tracksPending = file.HasTracks();
     } 
     catch (const std::out_of_range& oor) {
         cout << "Out of Range " << oor.what() << endl;
@@ -135,24 +148,19 @@ void GLWidget::setGeometry(QString filePath)
     initializeViewer();
     auto objNames = file.ObjectsNames();
     objsVisibility.clear();
+    vector<bool> visibility;
     for (auto &obj : objNames)
     {
-        objsVisibility[obj] = true;
+        // Objects hidden in a previous file keep hidden and were not decoded
+        objsVisibility[obj] = file.IsObjectVisible(obj);
+        visibility.push_back(objsVisibility[obj]);
     }
 
-    emit objectsNames(file.ObjectsNames());
-
-    auto labelNames = file.GetLabelsAtTime(0);
-    // cout << "Labels on glWidget" << endl;
-    // for (auto& obj: labelNames) {
-    //     cout << "Obj ";
-    //     for (auto& name: obj) {
-    //         cout << name << " ";
-    //     }
-    //     cout << endl;
-    // }
+    renderer.setObjectsVisibility(visibility);
+    emit objectsNames(file.ObjectsNames(), visibility);
 
-    setCurrentSnapshot(0, snapshots.front(), labelNames);
+    // Label ids are only meaningful inside a file, the labels are refreshed with the first frame
+    requestSnapshot(0);
 
     emit readTimeUnitsInfo((snapshots.size() - 1), scales.TUnit());
 
@@ -167,33 +175,88 @@ void GLWidget::resetPosition()
 
 void GLWidget::setAxesFlag(bool flag)
 {
-    showAxes = flag;
+    renderer.showAxes = flag;
     update();
 }
 
 void GLWidget::setGrid2DFlag(bool flag)
 {
-    showGrid2D = flag;
+    renderer.showGrid2D = flag;
     update();
 }
 
 void GLWidget::setGrid3DFlag(bool flag)
 {
-    showGrid3D = flag;
+    renderer.showGrid3D = flag;
     update();
 }
 
 void GLWidget::setTracksFlag(bool flag)
 {
-    showTracks = flag;
+    renderer.showTracks = flag;
+    update();
+}
+
+void GLWidget::setTracksTail(int tail)
+{
+    renderer.tracksTail = std::max(tail, 0);
+    update();
+}
+
+void GLWidget::setTracksFading(bool flag)
+{
+    renderer.tracksFading = flag;
+    update();
+}
+
+void GLWidget::setSphereMode(SphereMode mode)
+{
+    renderer.sphereMode = mode;
     update();
 }
 
+void GLWidget::setImpostorsThreshold(int threshold)
+{
+    renderer.impostorsThreshold = std::max(threshold, 0);
+    update();
+}
+
+void GLWidget::setQuantizedStorage(bool flag)
+{
+    // Applied when the next file is opened
+    file.SetQuantizedStorage(flag);
+}
+
 void GLWidget::setObjectShowFlag(string key, bool flag) {
     try {
+        bool changed = (objsVisibility[key] != flag);
         objsVisibility[key] = flag;
+        file.SetObjectVisibility(key, flag);
+        updateObjectsVisibility();
+
+        // Hidden objects are not kept in memory, they are decoded again when shown
+        auto objNames = file.ObjectsNames();
+        auto found = std::find(objNames.begin(), objNames.end(), key);
+        if (changed && !snapshots.empty() && (found != objNames.end())) {
+            int objIndex = std::distance(objNames.begin(), found);
+            waitForTracks();
+            if (flag) {
+                file.ReadObject(objIndex, snapshots);
+                // Track points of the object were not available while it was hidden
+                if (file.HasTracks()) {
+                    startTracks();
+                }
+            }
+            else {
+                file.ReleaseObject(objIndex, snapshots);
+            }
+            requestSnapshot(currentSnapshot.index);
+        }
         update(); 
     }
+    catch (const H5::Exception& e) {
+        cout << "GLWidget. Error at reading object " << key << " " << e.getCDetailMsg() << endl;
+    }
     catch (const std::exception& e) {
         cout << "GLWidget. Object key not found. " << e.what() << endl;
     }
@@ -202,6 +265,7 @@ void GLWidget::setObjectShowFlag(string key, bool flag) {
 void GLWidget::setLabelColor(int objIndex, string key, vector<float> color) {
     try {
         currentSnapshot.labelsColors[objIndex][key] = color;
+        updatePalette();
         update();
     }
     catch (const std::exception& e) {
@@ -217,6 +281,7 @@ void GLWidget::setLabelsOneColor(vector<float> color) {
             val = color;
         }
     }
+    updatePalette();
     update();
 }
 
@@ -224,6 +289,7 @@ void GLWidget::setDefaultLabelsColors()
 {
     auto labels = file.GetLabelsAtTime(currentSnapshot.index);
     setDefaultPaletteColors(labels);
+    updatePalette();
     update();
 }
 /**
@@ -232,197 +298,47 @@ void GLWidget::setDefaultLabelsColors()
 
 void GLWidget::initializeGL()
 {
-    initializeOpenGLFunctions();
-    qobj = gluNewQuadric();
-    GLfloat mat_ambient[] = { 0.5, 0.5, 0.5, 1.0 };
-    GLfloat mat_specular[] = { 0.5, 0.5, 0.5, 1.0 };
-    GLfloat mat_shininess[] = { 50.0 };
-    GLfloat light_position[] = { 1.0, 1.0, 1.0, 0.0 };
-    GLfloat model_ambient[] = { 0.5, 0.5, 0.5, 1.0 };
-    glClearColor(0, 0, 0, 1);
-    glMaterialfv(GL_FRONT, GL_AMBIENT, mat_ambient);
-    glMaterialfv(GL_FRONT, GL_SPECULAR, mat_specular);
-    glMaterialfv(GL_FRONT, GL_SHININESS, mat_shininess);
-    glLightfv(GL_LIGHT0, GL_POSITION, light_position);
-    glLightModelfv(GL_LIGHT_MODEL_AMBIENT, model_ambient);
+    renderer.initialize(context());
 }
 
 void GLWidget::paintGL()
 {
+    advanceInput();
     if (snapshots.empty()) 
         return;
 
     try {
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
-    glEnable(GL_LIGHTING);
-
-    glEnable(GL_LIGHT0);
-    glEnable(GL_SMOOTH);
-    glEnable(GL_COLOR_MATERIAL);
-    glLoadIdentity();
-    glTranslatef( 0.0, 0.0, -cameraZ);
-    glRotatef(m_xRot, 1.0, 0.0, 0.0);
-    glRotatef(m_yRot, 0.0, 1.0, 0.0);
-    if (scales.Type() == SpaceTime_t::ThreeDimension || scales.Type() == SpaceTime_t::ThreeDimensionAndTime) {
-        glRotatef(m_zRot, 0.0, 0.0, 1.0);
-    }
-    float cameraX = boundaries.minX+(boundaries.maxX-boundaries.minX)/2;
-    float cameraY = boundaries.minY+(boundaries.maxY-boundaries.minY)/2;
-    float cameraZ = boundaries.maxZ/2;
-
-    glTranslatef(-cameraX, -cameraY, -cameraZ);
-
-    auto& current_snapshot = currentSnapshot.snapshot;
-    int objIndex = 0;
-    for (auto& object : current_snapshot.GetObjects() )
-    {
-        // Make the object invisible according to the flag
-        auto key = file.ObjectsNames().at(objIndex);
-        objIndex++;
-        if (objsVisibility[key] == false) 
-        {
-            continue;
-        }
-
-        for (auto& subObject : object.GetAllSubObjects() )
-        {
-            EntityType subObjectType = subObject.first;
-            switch (subObjectType)
-            {
-            case EntityType::Line:
-                glDisable(GL_LIGHTING);
-                glDisable(GL_LIGHT0);
-            case EntityType::Face:
-                {
-                auto &entitiesBySID = subObject.second;
-                for (auto &entities : entitiesBySID)
-                {
-                    if (subObjectType == EntityType::Line)
-                        glBegin(GL_LINE_STRIP);
-                    if (subObjectType == EntityType::Face)
-                        glBegin(GL_POLYGON);
-                    for (auto &entity : entities)
-                    {
-                        // Eliminate last element used for storing the polyline box center
-                        if (&entity == &entities.back()) {
-                            continue;
-                        } 
-
-                        defineGLColor(entity.Label);
-                        switch (scales.Type())
-                        {
-                            case SpaceTime_t::TwoDimension:
-                            case SpaceTime_t::TwoDimensionAndTime:
-                                glVertex2f(scales.XScale() * entity.X(),
-                                           scales.YScale() * entity.Y() );
-                                break;
-                            case SpaceTime_t::ThreeDimension:
-                            case SpaceTime_t::ThreeDimensionAndTime:
-                                glVertex3f(scales.XScale() * entity.X(),
-                                           scales.YScale() * entity.Y(),
-                                           scales.ZScale() * entity.Z());
-                                break;
-                            default:
-                                break;
-                        }
-                    }
-                    glEnd();
-                }
-                }
-            break;
-            case EntityType::Point:
-                {
-                auto &entitiesBySID = subObject.second;
-                {
-                    auto &entities = entitiesBySID.front();
-                    glPointSize(pointSize);
-                    glBegin(GL_POINTS);
-
-                    for (auto &entity : entities)
-                    {
-                        defineGLColor(entity.Label);
-                        switch(scales.Type())
-                        {
-                            case SpaceTime_t::TwoDimension:
-                            case SpaceTime_t::TwoDimensionAndTime:
-                                glVertex2f(scales.XScale() * entity.X(),
-                                           scales.YScale() * entity.Y());
-                                break;
-                            case SpaceTime_t::ThreeDimension:
-                            case SpaceTime_t::ThreeDimensionAndTime:
-                                glVertex3f(scales.XScale() * entity.X(),
-                                           scales.YScale() * entity.Y(),
-                                           scales.ZScale() * entity.Z());
-                                break;
-                            default:
-                                break;
-                        }
-
-                    }
-                    glEnd();
-                }
-                }
-                break;
-            case EntityType::Circle:
-                break;
-            case EntityType::Sphere:
-                {
-                gluQuadricDrawStyle(qobj, GLU_FILL);
-                gluQuadricNormals(qobj, GLU_SMOOTH);
-                auto &entitiesBySID = subObject.second;
-                {
-                    auto &entities = entitiesBySID.front();
-                    for (auto &entity : entities)
-                    {
-                        defineGLColor(entity.Label);
-                        glPushMatrix();
-                        glTranslatef(scales.XScale() * entity.X(),
-                                     scales.YScale() * entity.Y(),
-                                     scales.ZScale() * entity.Z());
-                        // gluSphere(qobj, entity.Radius(), 15, 10);
-                        gluSphere(qobj, entity.Radius(), 6, 4);
-                        glPopMatrix();
-                    }
-                }
-                }
-                break;
-            case EntityType::Undefined:
-                break;
-            }
-        }
-    }
-
-    if (showAxes)
-        drawAxes();
-    if (showGrid2D)
-        drawGrid2D();
-    if (showGrid3D)
-        drawGrid3D();
-    if (showTracks && (tracks.size() > 0) ) {
-        drawTracks(currentSnapshot.index);
-    }
-    glFlush();
+        renderer.paint(currentSnapshot.index, {static_cast<float>(m_xRot), static_cast<float>(m_yRot), static_cast<float>(m_zRot), cameraZ});
     } catch (const std::exception& e) {
             cout << e.what() << endl;
     }
 
+    // Tracks are not needed for the first frame, they are created afterwards
+    if (tracksPending) {
+        tracksPending = false;
+        QTimer::singleShot(0, this, &GLWidget::startTracks);
+    }
+
 }
 
 void GLWidget::resizeGL(int w, int h)
 {
-    glViewport(0, 0, w, h);
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-    gluPerspective(45.0, (GLfloat)w / (GLfloat)h, 0.01f, 100000.0);
-    // glOrtho(-10.0, 70.0, -10.0, 60.0, 0, 10000);
-    glMatrixMode(GL_MODELVIEW);
+    renderer.resize(w, h, devicePixelRatioF());
 }
 
 void GLWidget::mousePressEvent(QMouseEvent *event)
 {
     m_lastPos = event->position().toPoint();
+    m_pressPos = m_lastPos;
+}
+
+void GLWidget::mouseReleaseEvent(QMouseEvent *event)
+{
+    // A click without dragging picks the entity under the cursor
+    QPoint position = event->position().toPoint();
+    if ( (event->button() == Qt::LeftButton) && ((position - m_pressPos).manhattanLength() <= clickPixels) ) {
+        pickEntity(position);
+    }
 }
 
 void GLWidget::mouseMoveEvent(QMouseEvent *event)
@@ -431,8 +347,9 @@ void GLWidget::mouseMoveEvent(QMouseEvent *event)
     int dy = event->position().toPoint().y() - m_lastPos.y();
 
     if (event->buttons() & Qt::LeftButton) {
-        setXRotation(m_xRot + 4 * dy);
-        setYRotation(m_yRot + 4 * dx);
+        // Applied once in the next frame
+        pendingDrag += QPoint(dx, dy);
+        requestFrame();
     } else if (event->buttons() & Qt::RightButton) {
 
     }
@@ -447,7 +364,7 @@ void GLWidget::wheelEvent(QWheelEvent *event)
         cameraZ += numPixels.y() * deltaZ;
     }
     event->accept();
-    update();
+    requestFrame();
 }
 
 void GLWidget::initializeViewer()
@@ -460,13 +377,12 @@ void GLWidget::initializeViewer()
     cout << " y " << boundaries.minY << " Y " << boundaries.maxY;
     cout << " z " << boundaries.minZ << " Z " << boundaries.maxZ << endl;
     cout << " Scales " << scales.XScale() << " " << scales.YScale() << " " << scales.ZScale() << endl;
+    cameraZ = renderer.defaultCamera().distance;
     if ((boundaries.maxZ == boundaries.minZ) && (boundaries.maxZ == 0.0)) {
-        cameraZ = boundaries.maxX / 2;
         deltaZ = 1.0;
     }
     else
     {
-        cameraZ = (boundaries.maxZ - boundaries.minZ) * 4.0;
         deltaZ = (boundaries.maxZ - boundaries.minZ) / 1000.0;
     }
 }
@@ -477,74 +393,11 @@ void GLWidget::initializeGamepad(QWidget* w)
         cout << "Gamepad null pointer";
         return;
     }
-    connect(m_gamepad, &QGamepad::axisLeftXChanged, w, 
-            [&](double value) { 
-                // qDebug() << "Jockstick Left X" << value;
-                float factor = m_gamepad->buttonR1() ? 100 : 10;
-                cameraZ -= deltaZ * value * factor;
-                update();
-                if ((value >= 1.0) || (value <= -0.99))
-                {
-                    auto eval = [game=m_gamepad, this]() -> float
-                    {
-                        float newValue = game->axisLeftX();
-                        float factor = game->buttonR1() ? 100 : 10;
-                        cameraZ -= deltaZ * newValue * factor;
-                        update();
-                        return newValue;
-                    };
-                    lockGamepadJoystick(value, eval);
-                }
-            });
-    connect(m_gamepad, &QGamepad::axisLeftYChanged, w, 
-            [&](double value) { 
-                // qDebug() << "Jockstick Left Y" << value;
-                float factor = m_gamepad->buttonR1() ? 100 : 10;
-                cameraZ += deltaZ * value * 10;
-                update();
-                if ((value >= 1.0) || (value <= -0.99))
-                {
-                    auto eval = [game=m_gamepad, this]() -> float
-                    {
-                        float newValue = game->axisLeftY();
-                        float factor = game->buttonR1() ? 100 : 10;
-                        cameraZ += deltaZ * newValue * factor;
-                        update();
-                        return newValue;
-                    };
-                    lockGamepadJoystick(value, eval);
-                }                
-            });
-    connect(m_gamepad, &QGamepad::axisRightXChanged, w, 
-            [&](double value) {          
-                // qDebug() << "Jockstick Right X" << value;
-                setYRotation(m_yRot + 4 * value);
-                if ((value >= 1.0) || (value <= -0.99))
-                {
-                    auto eval = [game=m_gamepad, this]() -> float
-                    {
-                        float newValue = game->axisRightX();
-                        setYRotation(m_yRot + 4 * newValue);
-                        return newValue;
-                    };
-                    lockGamepadJoystick(value, eval);
-                }
-            });
-    connect(m_gamepad, &QGamepad::axisRightYChanged, w, 
-            [&](double value) { 
-                // qDebug() << "Jocsktick Right Y" << value;
-                setXRotation(m_xRot + 4 * value);
-                if ((value >= 1.0) || (value <= -0.99))
-                {
-                    auto eval = [game=m_gamepad, this]() -> float
-                    {
-                        float newValue = game->axisRightY();
-                        setXRotation(m_xRot + 4 * newValue);
-                        return newValue;
-                    };
-                    lockGamepadJoystick(value, eval);
-                }
-            });
+    // Sticks are integrated every frame while they are deflected
+    connect(m_gamepad, &QGamepad::axisLeftXChanged, w, [this](double) { requestFrame(); });
+    connect(m_gamepad, &QGamepad::axisLeftYChanged, w, [this](double) { requestFrame(); });
+    connect(m_gamepad, &QGamepad::axisRightXChanged, w, [this](double) { requestFrame(); });
+    connect(m_gamepad, &QGamepad::axisRightYChanged, w, [this](double) { requestFrame(); });
     // connect(m_gamepad, &QGamepad::buttonAChanged, w, [](bool pressed)
     //         { 
     //             qDebug() << "Button A" << pressed; 
@@ -582,82 +435,42 @@ void GLWidget::initializeGamepad(QWidget* w)
     //             qDebug() << "Button R2: " << value;
     //         });
     connect(m_gamepad, &QGamepad::buttonUpChanged, w,
-            [&](bool pressed) {
-                // qDebug() << "Button Up " << pressed;
+            [this](bool pressed) {
                 if (pressed) {
                     emit moveToNextTime();
-                    if (m_gamepad->buttonR1())
-                    {
-                        auto eval = [game = m_gamepad, this]() -> bool
-                        {
-                            bool button = game->buttonUp();
-                            if (button)
-                            {
-                                emit moveToNextTime();
-                            }
-                            return button;
-                        };
-                        lockGamepadButton(eval);
+                    // Holding R1 keeps moving in time
+                    if (m_gamepad->buttonR1()) {
+                        startTimeRepeat(1);
                     }
-                }                
+                }
             });
     connect(m_gamepad, &QGamepad::buttonDownChanged, w,
-            [&](bool pressed) { 
-                // qDebug() << "Button Down" << pressed;
+            [this](bool pressed) {
                 if (pressed) {
                     emit moveToPrevTime();
-                    if (m_gamepad->buttonR1())
-                    {
-                        auto eval = [game = m_gamepad, this]() -> bool
-                        {
-                            bool button = game->buttonDown();
-                            if (button)
-                            {
-                                emit moveToPrevTime();
-                            }
-                            return button;
-                        };
-                        lockGamepadButton(eval);
+                    // Holding R1 keeps moving in time
+                    if (m_gamepad->buttonR1()) {
+                        startTimeRepeat(-1);
                     }
-                }  
+                }
             });
-    connect(m_gamepad, &QGamepad::buttonLeftChanged, w, 
-            [&](bool pressed) { 
-                // qDebug() << "Button Left: " << pressed;
+    connect(m_gamepad, &QGamepad::buttonLeftChanged, w,
+            [this](bool pressed) {
                 if (pressed) {
                     emit moveToPrevTime();
-                    if (m_gamepad->buttonR1())
-                    {
-                        auto eval = [game = m_gamepad, this]() -> bool
-                        {
-                            bool button = game->buttonLeft();
-                            if (button)
-                            {
-                                emit moveToPrevTime();
-                            }
-                            return button;
-                        };
-                        lockGamepadButton(eval);
+                    // Holding R1 keeps moving in time
+                    if (m_gamepad->buttonR1()) {
+                        startTimeRepeat(-1);
                     }
                 }
             });
-    connect(m_gamepad, &QGamepad::buttonRightChanged, w, [&](bool pressed)
-            { 
-                // qDebug() << "Button Right: " << pressed;
+    connect(m_gamepad, &QGamepad::buttonRightChanged, w,
+            [this](bool pressed) {
                 if (pressed) {
                     emit moveToNextTime();
-                    if (m_gamepad->buttonR1())
-                    {
-                        auto eval = [game = m_gamepad, this]() -> bool
-                        {
-                            bool button = game->buttonRight();
-                            if (button)
-                            {
-                                emit moveToNextTime();
-                            }
-                            return button;
-                        };
-                        lockGamepadButton(eval);
+                    // Holding R1 keeps moving in time
+                    if (m_gamepad->buttonR1()) {
+                        startTimeRepeat(1);
                     }
                 }
             });
@@ -674,216 +487,353 @@ void GLWidget::initializeGamepad(QWidget* w)
     //         });
 }
 
-void GLWidget::lockGamepadJoystick(float value, std::function<float()> evalFunction)
+void GLWidget::requestFrame()
 {
-    int timeLapse = 10;
+    if (!frameClock.isValid()) {
+        frameClock.start();
+    }
+    update();
+}
 
-    QTimer *timer = new QTimer(this);
-    connect(timer, &QTimer::timeout, this, [value, timer, evalFunction]() {
-        float newValue = evalFunction();
-        if (newValue != value) {
-            timer->stop();
-        }
-    });
-    timer->start(timeLapse);
+void GLWidget::startTimeRepeat(int direction)
+{
+    timeRepeat = direction;
+    timeRepeatClock.start();
+    requestFrame();
 }
 
-void GLWidget::lockGamepadButton(std::function<bool()> evalFunction)
+bool GLWidget::inputActive() const
 {
-    int timeLapse = 100;
+    if (!pendingDrag.isNull() || (timeRepeat != 0)) {
+        return true;
+    }
+    if (m_gamepad == nullptr) {
+        return false;
+    }
+    return (std::abs(m_gamepad->axisLeftX()) > gamepadDeadZone) || (std::abs(m_gamepad->axisLeftY()) > gamepadDeadZone) ||
+           (std::abs(m_gamepad->axisRightX()) > gamepadDeadZone) || (std::abs(m_gamepad->axisRightY()) > gamepadDeadZone);
+}
 
-    QTimer *timer = new QTimer(this);
-    connect(timer, &QTimer::timeout, this, [timer, evalFunction]() {
-        if (!evalFunction())
-        {
-            timer->stop();
-        }
-    });
-    timer->start(timeLapse);
-}
-
-void GLWidget::drawAxes()
-{
-    gluQuadricDrawStyle(qobj, GLU_FILL);
-    gluQuadricNormals(qobj, GLU_SMOOTH);
-    float height = (boundaries.maxX - boundaries.minX)/2;
-    float radius = height / 50.0;
-    // z axis
-    glColor4f(0, 0, 1, 0.5);
-    gluCylinder(qobj, radius, radius, height, 15, 10);
-    glPushMatrix();
-    glTranslatef(0.0, 0.0, height);
-    gluCylinder(qobj, radius*2.0, 0, height/10.0, 15, 10);
-    glPopMatrix();
-
-    // x axis
-    glColor4f(1, 0, 0, 0.5);
-    glPushMatrix();
-    glRotatef(90.0, 0, 1, 0);
-    gluCylinder(qobj, radius, radius, height, 15, 10);
-    glTranslatef(0.0, 0.0, height);
-    gluCylinder(qobj, radius*2.0, 0, height/10.0, 15, 10);
-    glPopMatrix();
-
-    // y axis
-    glColor4f(0, 1, 0, 0.5);
-    glPushMatrix();
-    glRotatef(-90.0, 1, 0, 0);
-    gluCylinder(qobj, radius, radius, height, 15, 10);
-    glTranslatef(0.0, 0.0, height);
-    gluCylinder(qobj, radius*2.0, 0, height/10.0, 15, 10);
-    glPopMatrix();
-}
-
-void GLWidget::drawPlaneGrid(pair<char, char>axes, int numLines, float freeAxis)
-{
-    if (axes.first == 'x' && axes.second == 'y')
-    {
-        for (int i = 0; i <= numLines; i++)
-        {
-            float val = i * pow(10.0, gridSpacing);
-            glVertex3f(val, 0.0, freeAxis * pow(10.0, gridSpacing) );
-            glVertex3f(val, numLines * pow(10.0, gridSpacing), freeAxis * pow(10.0, gridSpacing) );
-            glVertex3f(0.0, val, freeAxis * pow(10.0, gridSpacing) );
-            glVertex3f(numLines * pow(10.0, gridSpacing), val, freeAxis * pow(10.0, gridSpacing) );
+void GLWidget::advanceInput()
+{
+    // Seconds since the previous frame, a long pause does not make a jump
+    float elapsed = frameClock.isValid() ? std::min(frameClock.restart() / 1000.0f, 0.1f) : 0.0f;
+    float xRotation = 4.0f * pendingDrag.y();
+    float yRotation = 4.0f * pendingDrag.x();
+    pendingDrag = QPoint();
+
+    if (m_gamepad != nullptr) {
+        auto axis = [this](double value) { return (std::abs(value) > gamepadDeadZone) ? static_cast<float>(value) : 0.0f; };
+        float factor = m_gamepad->buttonR1() ? 10.0f : 1.0f;
+        cameraZ += deltaZ * (axis(m_gamepad->axisLeftY()) - axis(m_gamepad->axisLeftX())) * factor * gamepadZoomSpeed * elapsed;
+        xRotation += axis(m_gamepad->axisRightY()) * gamepadRotationSpeed * elapsed;
+        yRotation += axis(m_gamepad->axisRightX()) * gamepadRotationSpeed * elapsed;
+
+        if (timeRepeat != 0) {
+            bool held = (timeRepeat > 0) ? (m_gamepad->buttonUp() || m_gamepad->buttonRight()) :
+                                           (m_gamepad->buttonDown() || m_gamepad->buttonLeft());
+            if (!held) {
+                timeRepeat = 0;
+            }
+            else if (timeRepeatClock.elapsed() >= timeRepeatMilliseconds) {
+                timeRepeatClock.restart();
+                // The time changes after this frame, out of paintGL
+                if (timeRepeat > 0) {
+                    QTimer::singleShot(0, this, &GLWidget::moveToNextTime);
+                }
+                else {
+                    QTimer::singleShot(0, this, &GLWidget::moveToPrevTime);
+                }
+            }
         }
     }
 
-    if (axes.first == 'y' && axes.second == 'z')
-    {
-        for (int i = 0; i <= numLines; i++)
-        {
-            float val = i * pow(10.0, gridSpacing);
-            glVertex3f(freeAxis * pow(10.0, gridSpacing), val, 0.0);
-            glVertex3f(freeAxis * pow(10.0, gridSpacing), val, numLines * pow(10.0, gridSpacing));
-            glVertex3f(freeAxis * pow(10.0, gridSpacing), 0.0, val);
-            glVertex3f(freeAxis * pow(10.0, gridSpacing), numLines * pow(10.0, gridSpacing), val);
+    // Fractions of a degree step are kept for the next frames
+    xRotationRest += xRotation;
+    yRotationRest += yRotation;
+    int xStep = static_cast<int>(xRotationRest);
+    int yStep = static_cast<int>(yRotationRest);
+    xRotationRest -= xStep;
+    yRotationRest -= yStep;
+    m_xRot += xStep;
+    m_yRot += yStep;
+    qNormalizeAngle(m_xRot);
+    qNormalizeAngle(m_yRot);
+}
+
+void GLWidget::animateFrame()
+{
+    // The next frame follows the swap of this one while there is input, otherwise nothing runs
+    if (inputActive()) {
+        update();
+    }
+    else {
+        frameClock.invalidate();
+    }
+}
+
+void GLWidget::startTracks()
+{
+    // A running build is not waited for, its result is discarded by the generation
+    if (tracksWatcher.isRunning()) {
+        staleTracks.push_back(tracksWatcher.future());
+    }
+    staleTracks.erase(std::remove_if(staleTracks.begin(), staleTracks.end(),
+                                     [](const QFuture<tracksBuild>& task) { return task.isFinished(); }),
+                      staleTracks.end());
+    // Snapshots share their geometry blocks, the copy is a read-only view for the task
+    vector<BD5::Snapshot> views = snapshots;
+    BD5::ScaleUnit scaleUnit = scales;
+    vector<float> tolerances = renderer.tracksLodTolerances;
+    int generation = ++tracksGeneration;
+    tracksWatcher.setFuture( QtConcurrent::run([this, views, scaleUnit, tolerances, generation]() {
+        tracksBuild build;
+        build.generation = generation;
+        build.tracks = file.CreateTracks(views);
+        build.store = BD5::TrackStore(build.tracks);
+        build.store.Scale(scaleUnit.XScale(), scaleUnit.YScale(), scaleUnit.ZScale());
+        for (auto tolerance: tolerances) {
+            build.lods.push_back(build.store.Simplify(tolerance));
         }
+        return build;
+    }) );
+}
+
+void GLWidget::publishTracks()
+{
+    tracksBuild build = tracksWatcher.result();
+    if (build.generation != tracksGeneration) {
+        return;
     }
+    file.SetTracks(build.tracks);
+    renderer.setTracks(std::move(build.store), std::move(build.lods));
+    emit tracksReady(renderer.numTracks() > 0);
+    update();
 }
 
-void GLWidget::drawGrid2D()
+void GLWidget::waitForTracks()
 {
-    pair xyAxis('x', 'y');
-    glColor3f(0.5, 0.5, 0.5);
-    glBegin(GL_LINES);    
-        drawPlaneGrid(xyAxis, linesPerGrid, 0);
-    glEnd();
+    // Tasks only read the BD5File, every build is waited for before it is modified
+    tracksWatcher.waitForFinished();
+    for (auto& task: staleTracks) {
+        task.waitForFinished();
+    }
+    staleTracks.clear();
 }
 
+void GLWidget::requestSnapshot(int index)
+{
+    // Only one frame is prepared at a time, the times requested meanwhile are coalesced in the last one
+    requestedIndex = index;
+    if (!framePending) {
+        startFrame();
+    }
+}
 
-void GLWidget::drawGrid3D()
+void GLWidget::startFrame()
 {
-    pair xyAxis('x', 'y');
-    pair yzAxis('y', 'z');
-    glColor3f(0.5, 0.5, 0.5);
-    glBegin(GL_LINES);
-        if (scales.Type() == SpaceTime_t::ThreeDimension || scales.Type() == SpaceTime_t::ThreeDimensionAndTime)
-        {
-            for (int i = 0; i <= linesPerGrid; i++) {
-                drawPlaneGrid(xyAxis, linesPerGrid, i);
-                drawPlaneGrid(yzAxis, linesPerGrid, i);
+    int index = requestedIndex;
+    requestedIndex = -1;
+    // The task works on copies. Snapshots share their geometry blocks and the dictionary only 
+    // grows, its copy is renewed when labels are added
+    auto& dictionary = file.GetLabelDictionary();
+    if (!labelsView || (labelsView->Size() != dictionary.Size())) {
+        labelsView = std::make_shared<const BD5::LabelDictionary>(dictionary);
+    }
+    BD5::Snapshot view = snapshots.at(index);
+    BD5::Snapshot front = currentSnapshot.snapshot;
+    bool hasMesh = !renderer.mesh().Ranges().empty();
+    vector<LabelSet> labelSets = file.GetLabelSetsAtTime(index);
+    vector<LabelSet> frontLabelSets = currentSnapshot.labelSets;
+    BD5::ScaleUnit scaleUnit = scales;
+    auto labels = labelsView;
+    int generation = frameGeneration;
+    framePending = true;
+    frameWatcher.setFuture( QtConcurrent::run([index, view, front, hasMesh, labelSets, frontLabelSets, scaleUnit, labels, generation]() {
+        frameBuild build;
+        build.generation = generation;
+        build.frame.index = index;
+        build.frame.snapshot = view;
+
+        // Consecutive times with the same geometry keep the uploaded mesh
+        auto& previous = front.GetObjects();
+        auto& objects = view.GetObjects();
+        bool sameGeometry = hasMesh && (previous.size() == objects.size()) &&
+            std::equal(objects.begin(), objects.end(), previous.begin(), 
+                [](const BD5::Object& a, const BD5::Object& b) { return a.SharesGeometryWith(b); });
+        if (!sameGeometry) {
+            build.newMesh = true;
+            build.mesh = BD5::SnapshotMesh(view, scaleUnit, *labels);
+            build.index = BD5::SpatialIndex(build.mesh.Batches());
+        }
+
+        // Colors and labels panel are only rebuilt when the labels present change
+        if (labelSets.empty() || (labelSets != frontLabelSets)) {
+            build.labelsChanged = true;
+            build.frame.labelSets = labelSets;
+            for (auto& set : labelSets) {
+                vector<string> names;
+                for (auto id : set.Ids()) {
+                    names.push_back(labels->Name(id));
+                }
+                build.labels.push_back(names);
             }
+            ColorPalette palette;
+            build.frame.labelsColors = palette.GetLabelsColors(build.labels);
+            build.palette = SceneRenderer::buildPalette(build.frame.labelsColors, *labels);
+        }
+        return build;
+    }) );
+}
+
+void GLWidget::publishFrame()
+{
+    framePending = false;
+    frameBuild build = frameWatcher.result();
+    if (build.generation == frameGeneration) {
+        // The prepared frame replaces the current one
+        currentSnapshot.index = build.frame.index;
+        currentSnapshot.snapshot = std::move(build.frame.snapshot);
+        if (build.newMesh) {
+            renderer.setMesh(std::move(build.mesh));
+            renderer.setSpatialIndex(std::move(build.index));
+            auto& index = renderer.spatialIndex();
+            std::ostringstream ss;
+            ss << __FILE__ << ":" << __func__ << "() " << "Spatial index " << index.NumBatches() << " batches " << index.NumNodes()
+               << " nodes " << index.MemoryBytes() / 1024 << " KiB built in " << index.BuildMilliseconds() << " ms";
+            file.LogInfo(ss.str());
+        }
+        if (build.labelsChanged) {
+            currentSnapshot.labelSets = std::move(build.frame.labelSets);
+            currentSnapshot.labelsColors = std::move(build.frame.labelsColors);
+            renderer.setPalette(std::move(build.palette));
+            emit labelsNames(file.ObjectsNames(), build.labels);
         }
-    glEnd();
+        emit snapshotTime(currentSnapshot.snapshot.Time() * scales.TScale());
+        update();
+    }
+    if (requestedIndex >= 0) {
+        startFrame();
+    }
 }
 
-int GLWidget::getGridSpacing(Boundaries box)
+void GLWidget::pickEntity(QPoint position)
 {
-    for (int i = 0; i < 10; i++)
+    // The index of a previous mesh is kept until the new one is set, its batches do not match
+    auto& snapshotMesh = renderer.mesh();
+    if (!renderer.hasPainted() || snapshotMesh.Ranges().empty() || !renderer.hasSpatialIndex() || (height() == 0)) {
+        return;
+    }
+    const GLfloat* pickProjection = renderer.lastProjection();
+
+    // Ray from the camera through the pixel. The eye direction is given by the projection,
+    // the inverse of the modelview takes it to the snapshot coordinates
+    float ndcX = 2.0f * position.x() / width() - 1.0f;
+    float ndcY = 1.0f - 2.0f * position.y() / height();
+    QVector4D eyeDirection((ndcX + pickProjection[8]) / pickProjection[0], (ndcY + pickProjection[9]) / pickProjection[5], -1.0f, 0.0f);
+    QMatrix4x4 inverse = QMatrix4x4(renderer.lastModelview()).transposed().inverted();
+    QVector3D origin = (inverse * QVector4D(0.0f, 0.0f, 0.0f, 1.0f)).toVector3D();
+    QVector3D direction = (inverse * eyeDirection).toVector3D().normalized();
+    float rayOrigin[3] = {origin.x(), origin.y(), origin.z()};
+    float rayDirection[3] = {direction.x(), direction.y(), direction.z()};
+    // Points and lines are hit within a few pixels
+    float tolerance = 2.0f * pickPixels / (height() * pickProjection[5]);
+
+    auto objNames = file.ObjectsNames();
+    pickableRanges.clear();
+    for (auto& range : snapshotMesh.Ranges()) {
+        pickableRanges.push_back(objsVisibility[objNames.at(range.object)]);
+    }
+    BD5::MeshHit hit;
+    bool found = renderer.spatialIndex().RayCast(snapshotMesh, rayOrigin, rayDirection, tolerance, hit, &pickableRanges);
+    emit entityPicked(found ? describeHit(hit) : QString());
+}
+
+QString GLWidget::describeHit(const BD5::MeshHit& hit)
+{
+    auto& snapshotMesh = renderer.mesh();
+    auto& range = snapshotMesh.Ranges()[hit.range];
+    auto& object = currentSnapshot.snapshot.GetObjects().at(range.object);
+    bool spheres = (range.type == EntityType::Sphere);
+    int entity = spheres ? snapshotMesh.InstanceEntities()[hit.element] : snapshotMesh.VertexEntities()[hit.element];
+    int group = std::max(0, snapshotMesh.Batches()[hit.batch].group);
+
+    string ID;
+    string label;
+    float x, y, z;
+    if (object.IsQuantizedSubObject(range.subObject))
+    {
+        auto& entities = object.GetQuantizedSubObject(range.subObject);
+        ID = entities.ID(entity);
+        label = entities.Label(entity);
+        x = entities.X(entity);
+        y = entities.Y(entity);
+        z = entities.Is3D() ? entities.Z(entity) : 0.0f;
+    }
+    else
     {
-        int positive = static_cast<int> (box.maxX - box.minX) / (pow(10.0, i));
-        if (positive > 0 && positive < 10)
-            return i;
-        int negative = static_cast<int> (box.maxX - box.minX) / (pow(10.0, -i));
-        if (negative > 0 && negative < 10)
-            return -i;
-    }
-    return 1;
-}
-
-void GLWidget::drawTracks(int t)
-{
-    vector<vector<PointTrack>> filteredTracks;
-    for (auto& track : tracks) {
-        vector<PointTrack> fTrack (track.size() );
-        auto it = std::copy_if(track.begin(), track.end(), fTrack.begin(),
-                    [&t](PointTrack& pT){ return (pT.id <= t); });
-        fTrack.resize(std::distance(fTrack.begin(), it));
-        if (fTrack.size() > 0) {
-            filteredTracks.push_back(fTrack);
+        auto& data = object.GetSubObject(range.subObject).at(group).at(entity);
+        ID = data.ID;
+        label = data.Label;
+        x = data.X();
+        y = data.Y();
+        z = data.HasElement('z') ? data.Z() : 0.0f;
+        // Polylines and faces keep their ID out of band
+        auto& polylines = object.GetPolylinesAtSubObject(range.subObject);
+        if (ID.empty() && (static_cast<size_t>(group) < polylines.size())) {
+            ID = polylines[group].ID;
         }
     }
 
-    int colorIndex = 0;
-    ColorPalette palette;
+    static const map<EntityType, QString> typeNames = { {EntityType::Point, "point"}, {EntityType::Line, "line"},
+                                                        {EntityType::Face, "face"}, {EntityType::Sphere, "sphere"} };
+    QString text = QString("Object: %1 (%2)\n").arg(QString::fromStdString(file.ObjectsNames().at(range.object)), typeNames.at(range.type));
+    text += QString("ID: %1\n").arg(QString::fromStdString(ID));
+    text += QString("Label: %1\n").arg(label.empty() ? QString("-") : QString::fromStdString(label));
+    text += QString("x: %1\ny: %2\nz: %3").arg(x).arg(y).arg(z);
+    if (spheres) {
+        text += QString("\nRadius: %1").arg(snapshotMesh.Instances()[4 * hit.element + 3]);
+    }
 
-    for (auto& track : filteredTracks ) {
-        vector<GLfloat> color = palette.GetColorAt(colorIndex);
-        glColor3f(color.at(0), color.at(1), color.at(2));
-        colorIndex++;
-        glBegin(GL_LINE_STRIP);
-        for (auto& line : track) {
-            glVertex3f(scales.XScale() * line.x,
-                        scales.YScale() * line.y,
-                        scales.ZScale() * line.z);
+    auto& lineage = file.GetLineage();
+    int node = lineage.Find(ID);
+    if (node < 0) {
+        return text;
+    }
+    auto nodesIDs = [&lineage](const vector<int>& nodes) {
+        QStringList ids;
+        for (auto index : nodes) {
+            ids << QString::fromStdString(lineage.Node(index).ID);
         }
-        glEnd();
+        return ids.isEmpty() ? QString("-") : ids.join(", ");
+    };
+    auto ancestors = lineage.Ancestors(node);
+    text += QString("\n\nTrack from: %1").arg(QString::fromStdString(lineage.Node(ancestors.empty() ? node : ancestors.back()).ID));
+    if (lineage.Time(node) >= 0) {
+        text += QString("\nFirst time index: %1").arg(lineage.Time(node));
     }
-}
-
-void GLWidget::setCurrentSnapshot(int index, BD5::Snapshot& snapshot, vector<vector<string>> labels)
-{
-    currentSnapshot.index = index;
-    currentSnapshot.snapshot = snapshot;
-    setDefaultPaletteColors(labels);
-    emit labelsNames(file.ObjectsNames(), labels);
+    text += QString("\nGeneration: %1, depth: %2").arg(lineage.Generation(node)).arg(lineage.Depth(node));
+    text += QString("\nParents: %1").arg(nodesIDs(lineage.Node(node).parents));
+    text += QString("\nChildren: %1").arg(nodesIDs(lineage.Node(node).children));
+    return text;
 }
 
 void GLWidget::setDefaultPaletteColors(vector<vector<string>> objLabels)
 {
-    currentSnapshot.labelsColors.clear();
-    int i = 0;
     ColorPalette palette;
-    for (auto &obj: objLabels)
-    {
-        map<string, vector<float>> objLabelsColors;
-        for (auto &label : obj)
-        {
-            objLabelsColors[label] = palette.GetColorAt(i);
-            i++;
-        }
-        currentSnapshot.labelsColors.push_back(objLabelsColors);
-    }
+    currentSnapshot.labelsColors = palette.GetLabelsColors(objLabels);
 }
 
-void GLWidget::defineGLColor(string label)
+void GLWidget::updatePalette()
 {
-    // Default color
-    glColor3f(1.0, 1.0, 1.0);
+    renderer.setPalette(SceneRenderer::buildPalette(currentSnapshot.labelsColors, file.GetLabelDictionary()));
+}
 
-    // Change entity color base on the label color
-    if (!label.empty() && !currentSnapshot.labelsColors.empty())
-    {
-        try
-        {
-            for (auto &obj: currentSnapshot.labelsColors)
-            {
-                auto it = obj.find(label);
-                if (it != obj.end())
-                {
-                    auto color = it->second;
-                    glColor3fv(color.data());
-                }
-            }
-        }
-        catch (const std::out_of_range &ofr)
-        {
-            cout << "No in range " << ofr.what() << " " << label << " ";
-        }
-        catch (const std::exception &e)
-        {
-            cout << "On defineGLColor: " << e.what() << endl;
-        }
+void GLWidget::updateObjectsVisibility()
+{
+    vector<bool> visibility;
+    for (auto& obj : file.ObjectsNames()) {
+        visibility.push_back(objsVisibility[obj]);
     }
-}
\ No newline at end of file
+    renderer.setObjectsVisibility(visibility);
+}
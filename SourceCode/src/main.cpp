@@ -5,13 +5,30 @@
 #include <QCommandLineOption>
 #include <QtGamepad/QGamepadManager>
 #include <QWindow>
+#include <cstring>
+#include <cstdlib>
 
 #include "glwidget.h"
 #include "mainwindow.h"
+#include "exporter.h"
 
 
 int main(int argc, char *argv[])
 {
+    // Exporting opens no window, it uses the offscreen platform. Its OpenGL contexts come from
+    // the X server (GLX), nodes without a display run the export in a virtual one (Xvfb)
+    bool exporting = false;
+    for (int i = 1; i < argc; i++) {
+        exporting = exporting || (strcmp(argv[i], "-e") == 0) || (strncmp(argv[i], "--export", 8) == 0);
+    }
+    if (exporting && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        if (qEnvironmentVariableIsEmpty("DISPLAY")) {
+            cout << "Export needs an X server for OpenGL. Without a display run it in a virtual one:" << endl;
+            cout << "xvfb-run -a BD5Viewer -e <directory> <file>" << endl;
+            return 1;
+        }
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
     QApplication app(argc, argv);
 
     QCoreApplication::setApplicationName("BD5Viewer");
@@ -24,9 +41,56 @@ int main(int argc, char *argv[])
 
     QCommandLineOption withGamepad("g", QCoreApplication::translate("main", "Connect gamepad"));
     parser.addOption(withGamepad);
+    QCommandLineOption exportDir(QStringList() << "e" << "export", QCoreApplication::translate("main", "Render the times of <file> to numbered PNG images in <directory> and exit"), "directory");
+    parser.addOption(exportDir);
+    QCommandLineOption firstTime("first", QCoreApplication::translate("main", "First time index to export"), "index", "0");
+    parser.addOption(firstTime);
+    QCommandLineOption lastTime("last", QCoreApplication::translate("main", "Last time index to export, the last time by default"), "index", "-1");
+    parser.addOption(lastTime);
+    QCommandLineOption imageSize("size", QCoreApplication::translate("main", "Size of the exported images"), "WxH", "1920x1080");
+    parser.addOption(imageSize);
+    QCommandLineOption withTracks("tracks", QCoreApplication::translate("main", "Export the tracks"));
+    parser.addOption(withTracks);
+    QCommandLineOption withAxes("axes", QCoreApplication::translate("main", "Export the axes"));
+    parser.addOption(withAxes);
+    QCommandLineOption withGrid("grid", QCoreApplication::translate("main", "Export the grid"));
+    parser.addOption(withGrid);
+    QCommandLineOption xRotation("xrot", QCoreApplication::translate("main", "Rotation of the camera around x in degrees"), "degrees", "0");
+    parser.addOption(xRotation);
+    QCommandLineOption yRotation("yrot", QCoreApplication::translate("main", "Rotation of the camera around y in degrees"), "degrees", "0");
+    parser.addOption(yRotation);
+    QCommandLineOption yRotationStep("yrot-step", QCoreApplication::translate("main", "Rotation around y added every exported time"), "degrees", "0");
+    parser.addOption(yRotationStep);
+    parser.addPositionalArgument("file", QCoreApplication::translate("main", "BD5 file to export"));
 
     parser.process(app);
 
+    if (parser.isSet(exportDir)) {
+        if (parser.positionalArguments().isEmpty()) {
+            cout << "Export needs a BD5 file" << endl;
+            return 1;
+        }
+        exportOptions options;
+        options.input = parser.positionalArguments().first();
+        options.outputDir = parser.value(exportDir);
+        options.first = parser.value(firstTime).toInt();
+        options.last = parser.value(lastTime).toInt();
+        QStringList size = parser.value(imageSize).split('x');
+        if ( (size.size() != 2) || (size[0].toInt() <= 0) || (size[1].toInt() <= 0) ) {
+            cout << "Wrong image size " << parser.value(imageSize).toStdString() << endl;
+            return 1;
+        }
+        options.size = QSize(size[0].toInt(), size[1].toInt());
+        options.tracks = parser.isSet(withTracks);
+        options.axes = parser.isSet(withAxes);
+        options.grid = parser.isSet(withGrid);
+        options.xRotation = parser.value(xRotation).toFloat();
+        options.yRotation = parser.value(yRotation).toFloat();
+        options.yRotationStep = parser.value(yRotationStep).toFloat();
+        FrameExporter exporter(options);
+        return exporter.run();
+    }
+
     if (parser.isSet(withGamepad)) {
         do
         {
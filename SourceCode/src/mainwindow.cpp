@@ -12,6 +12,10 @@
 #include <QFileInfo>
 #include <QLabel>
 #include <QApplication>
+#include <QInputDialog>
+#include <QSignalBlocker>
+#include <QActionGroup>
+#include <climits>
 
 MainWindow::MainWindow()
 {
@@ -24,6 +28,16 @@ MainWindow::MainWindow()
     menuFile->addAction(openFile);
     connect(openFile, &QAction::triggered, this, &MainWindow::onOpenFile);
 
+    QAction *quantized = new QAction(menuFile);
+    quantized->setText(tr("&Quantized storage"));
+    quantized->setToolTip(tr("Store point and sphere coordinates as 16-bit integers on the next open"));
+    quantized->setCheckable(true);
+    menuFile->addAction(quantized);
+    connect(quantized, &QAction::toggled, this,
+            [this](bool flag) {
+                emit quantizedStorageChanged(flag);
+            });
+
     QAction *exit = new QAction(menuFile);
     exit->setText(tr("E&xit"));
     menuFile->addAction(exit);
@@ -40,6 +54,67 @@ MainWindow::MainWindow()
                 emit resetRequested();
             });
 
+    QAction *tracksTail = new QAction(menuView);
+    tracksTail->setText(tr("Tracks &tail"));
+    tracksTail->setToolTip(tr("Draw only the last times of every track"));
+    tracksTail->setCheckable(true);
+    menuView->addAction(tracksTail);
+    connect(tracksTail, &QAction::toggled, this,
+            [this, tracksTail](bool flag) {
+                int tail = 0;
+                if (flag) {
+                    bool accepted = false;
+                    tail = QInputDialog::getInt(this, tr("Tracks tail"), tr("Number of times:"), 10, 1, 100000, 1, &accepted);
+                    if (!accepted) {
+                        QSignalBlocker blocker(tracksTail);
+                        tracksTail->setChecked(false);
+                        tail = 0;
+                    }
+                }
+                emit tracksTailChanged(tail);
+            });
+
+    QAction *tracksFading = new QAction(menuView);
+    tracksFading->setText(tr("Tracks tail &fading"));
+    tracksFading->setCheckable(true);
+    menuView->addAction(tracksFading);
+    connect(tracksFading, &QAction::toggled, this,
+            [this](bool flag) {
+                emit tracksFadingChanged(flag);
+            });
+
+    QMenu *menuSpheres = menuView->addMenu(tr("&Spheres"));
+    QActionGroup *sphereModes = new QActionGroup(menuSpheres);
+    auto addSphereMode = [this, menuSpheres, sphereModes](QString text, SphereMode mode) {
+        QAction *action = new QAction(sphereModes);
+        action->setText(text);
+        action->setCheckable(true);
+        action->setChecked(mode == SphereMode::Automatic);
+        menuSpheres->addAction(action);
+        connect(action, &QAction::triggered, this,
+                [this, mode]() {
+                    emit sphereModeChanged(mode);
+                });
+    };
+    addSphereMode(tr("&Automatic"), SphereMode::Automatic);
+    addSphereMode(tr("&Meshes"), SphereMode::Meshes);
+    addSphereMode(tr("&Impostors"), SphereMode::Impostors);
+    menuSpheres->addSeparator();
+
+    QAction *threshold = new QAction(menuSpheres);
+    threshold->setText(tr("Impostors &threshold"));
+    threshold->setToolTip(tr("Number of spheres from which the automatic mode draws impostors"));
+    menuSpheres->addAction(threshold);
+    connect(threshold, &QAction::triggered, this,
+            [this]() {
+                bool accepted = false;
+                int value = QInputDialog::getInt(this, tr("Impostors threshold"), tr("Number of spheres:"), impostorsThreshold, 0, INT_MAX, 1000, &accepted);
+                if (accepted) {
+                    impostorsThreshold = value;
+                    emit impostorsThresholdChanged(value);
+                }
+            });
+
     setMenuBar(menuBar);
     statusBar = new QStatusBar(this);
     QCheckBox *axes = new QCheckBox("Axes", this);
@@ -51,6 +126,9 @@ MainWindow::MainWindow()
     axes->setCheckState(Qt::Unchecked);
     grid2D->setCheckState(Qt::Unchecked);
     tracks->setCheckState(Qt::Unchecked);
+    // Enabled when the tracks of the file are created
+    tracks->setEnabled(false);
+    tracksCheck = tracks;
     statusBar->addPermanentWidget(axes);
     statusBar->addPermanentWidget(grid2D);
     statusBar->addPermanentWidget(grid3D);
@@ -92,3 +170,7 @@ void MainWindow::onOpenFile()
     }
 }
 
+void MainWindow::setTracksEnabled(bool flag)
+{
+    tracksCheck->setEnabled(flag);
+}
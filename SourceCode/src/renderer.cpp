@@ -0,0 +1,1196 @@
+#include <QOpenGLContext>
+#include <QOpenGLFunctions_2_1>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLExtraFunctions>
+#include <QOpenGLVersionFunctionsFactory>
+#include <QMatrix4x4>
+#include <math.h>
+#include <algorithm>
+#include "renderer.h"
+
+using namespace BD5;
+using namespace std;
+
+SceneRenderer::SceneRenderer()
+{
+    m_core = QSurfaceFormat::defaultFormat().profile() == QSurfaceFormat::CoreProfile;
+}
+
+void SceneRenderer::destroy()
+{
+    tracksVertexBuffer.destroy();
+    tracksColorBuffer.destroy();
+    tracksTimeBuffer.destroy();
+    glDeleteTextures(1, &tracksFadeTexture);
+    snapshotVertexBuffer.destroy();
+    snapshotLabelBuffer.destroy();
+    snapshotNormalBuffer.destroy();
+    snapshotIndexBuffer.destroy();
+    sphereVertexBuffer.destroy();
+    sphereIndexBuffer.destroy();
+    impostorVertexBuffer.destroy();
+    spheresInstanceBuffer.destroy();
+    spheresLabelBuffer.destroy();
+    axesBuffer.destroy();
+    grid2DBuffer.destroy();
+    grid3DBuffer.destroy();
+    glDeleteTextures(1, &paletteTexture);
+    snapshotVao.destroy();
+    delete snapshotProgram;
+    snapshotProgram = nullptr;
+    delete sphereProgram;
+    sphereProgram = nullptr;
+    delete impostorProgram;
+    impostorProgram = nullptr;
+}
+
+void SceneRenderer::setScene(const BD5::ScaleUnit& scaleUnit, const BD5::Boundaries& box)
+{
+    scales = scaleUnit;
+    boundaries = box;
+    gridSpacing = getGridSpacing(boundaries);
+    furnitureUploaded = false;
+}
+
+sceneCamera SceneRenderer::defaultCamera() const
+{
+    sceneCamera camera;
+    if ((boundaries.maxZ == boundaries.minZ) && (boundaries.maxZ == 0.0)) {
+        camera.distance = boundaries.maxX / 2;
+    }
+    else {
+        camera.distance = (boundaries.maxZ - boundaries.minZ) * 4.0;
+    }
+    return camera;
+}
+
+void SceneRenderer::setMesh(BD5::SnapshotMesh newMesh)
+{
+    snapshotMesh = std::move(newMesh);
+    snapshotUploaded = false;
+    indexReady = false;
+}
+
+const BD5::SnapshotMesh& SceneRenderer::mesh() const
+{
+    return snapshotMesh;
+}
+
+void SceneRenderer::setSpatialIndex(BD5::SpatialIndex newIndex)
+{
+    index = std::move(newIndex);
+    indexReady = true;
+}
+
+bool SceneRenderer::hasSpatialIndex() const
+{
+    return indexReady;
+}
+
+const BD5::SpatialIndex& SceneRenderer::spatialIndex() const
+{
+    return index;
+}
+
+void SceneRenderer::setPalette(scenePalette newPalette)
+{
+    palette = std::move(newPalette);
+    paletteUploaded = false;
+}
+
+void SceneRenderer::setObjectsVisibility(vector<bool> visibility)
+{
+    objectsVisibility = std::move(visibility);
+}
+
+bool SceneRenderer::isObjectVisible(int object) const
+{
+    return (static_cast<size_t>(object) >= objectsVisibility.size()) || objectsVisibility[object];
+}
+
+size_t SceneRenderer::numTracks() const
+{
+    return tracks.NumTracks();
+}
+
+const GLfloat* SceneRenderer::lastProjection() const
+{
+    return projection;
+}
+
+const GLfloat* SceneRenderer::lastModelview() const
+{
+    return modelview;
+}
+
+bool SceneRenderer::hasPainted() const
+{
+    return painted;
+}
+
+static const char *snapshotVertexShaderSourceCore =
+    "#version 150\n"
+    "in vec4 vertex;\n"
+    "in float label;\n"
+    "in vec3 normal;\n"
+    "uniform sampler2D palette;\n"
+    "uniform vec2 paletteSize;\n"
+    "out vec3 vertColor;\n"
+    "out vec3 vertNormal;\n"
+    "uniform mat4 projMatrix;\n"
+    "uniform mat4 mvMatrix;\n"
+    "void main() {\n"
+    "   vec4 position = mvMatrix * vertex;\n"
+    "   vertColor = (label < 0.0) ? vec3(1.0) : texelFetch(palette, ivec2(mod(label, paletteSize.x), floor(label / paletteSize.x)), 0).rgb;\n"
+    "   vertNormal = (mvMatrix * vec4(normal, 0.0)).xyz;\n"
+    "   gl_Position = projMatrix * position;\n"
+    "}\n";
+
+static const char *snapshotFragmentShaderSourceCore =
+    "#version 150\n"
+    "in vec3 vertColor;\n"
+    "in vec3 vertNormal;\n"
+    "out highp vec4 fragColor;\n"
+    "uniform bool lit;\n"
+    "void main() {\n"
+    "   vec3 color = vertColor;\n"
+    "   if (lit) {\n"
+    "       vec3 normal = normalize(vertNormal);\n"
+    "       vec3 light = normalize(vec3(1.0, 1.0, 1.0));\n"
+    "       color = min(color * (0.5 + max(dot(normal, light), 0.0)), 1.0);\n"
+    "   }\n"
+    "   fragColor = vec4(color, 1.0);\n"
+    "}\n";
+
+static const char *snapshotVertexShaderSource =
+    "attribute vec4 vertex;\n"
+    "attribute float label;\n"
+    "attribute vec3 normal;\n"
+    "uniform sampler2D palette;\n"
+    "uniform vec2 paletteSize;\n"
+    "varying vec3 vertColor;\n"
+    "varying vec3 vertNormal;\n"
+    "uniform mat4 projMatrix;\n"
+    "uniform mat4 mvMatrix;\n"
+    "void main() {\n"
+    "   vec4 position = mvMatrix * vertex;\n"
+    "   vertColor = (label < 0.0) ? vec3(1.0) : texture2DLod(palette, (vec2(mod(label, paletteSize.x), floor(label / paletteSize.x)) + 0.5) / paletteSize, 0.0).rgb;\n"
+    "   vertNormal = (mvMatrix * vec4(normal, 0.0)).xyz;\n"
+    "   gl_Position = projMatrix * position;\n"
+    "}\n";
+
+static const char *snapshotFragmentShaderSource =
+    "varying highp vec3 vertColor;\n"
+    "varying highp vec3 vertNormal;\n"
+    "uniform bool lit;\n"
+    "void main() {\n"
+    "   highp vec3 color = vertColor;\n"
+    "   if (lit) {\n"
+    "       highp vec3 normal = normalize(vertNormal);\n"
+    "       highp vec3 light = normalize(vec3(1.0, 1.0, 1.0));\n"
+    "       color = min(color * (0.5 + max(dot(normal, light), 0.0)), 1.0);\n"
+    "   }\n"
+    "   gl_FragColor = vec4(color, 1.0);\n"
+    "}\n";
+
+static const char *sphereVertexShaderSourceCore =
+    "#version 150\n"
+    "in vec4 vertex;\n"
+    "in vec4 instance;\n"
+    "in float label;\n"
+    "uniform sampler2D palette;\n"
+    "uniform vec2 paletteSize;\n"
+    "out vec3 vertColor;\n"
+    "out vec3 vertNormal;\n"
+    "uniform mat4 projMatrix;\n"
+    "uniform mat4 mvMatrix;\n"
+    "void main() {\n"
+    "   vertColor = (label < 0.0) ? vec3(1.0) : texelFetch(palette, ivec2(mod(label, paletteSize.x), floor(label / paletteSize.x)), 0).rgb;\n"
+    "   vertNormal = (mvMatrix * vec4(vertex.xyz, 0.0)).xyz;\n"
+    "   gl_Position = projMatrix * mvMatrix * vec4(instance.xyz + instance.w * vertex.xyz, 1.0);\n"
+    "}\n";
+
+static const char *sphereFragmentShaderSourceCore =
+    "#version 150\n"
+    "in vec3 vertColor;\n"
+    "in vec3 vertNormal;\n"
+    "out highp vec4 fragColor;\n"
+    "void main() {\n"
+    "   vec3 normal = normalize(vertNormal);\n"
+    "   vec3 light = normalize(vec3(1.0, 1.0, 1.0));\n"
+    "   vec3 halfway = normalize(light + vec3(0.0, 0.0, 1.0));\n"
+    "   float diffuse = max(dot(normal, light), 0.0);\n"
+    "   float specular = (diffuse > 0.0) ? 0.5 * pow(max(dot(normal, halfway), 0.0), 50.0) : 0.0;\n"
+    "   fragColor = vec4(min(vertColor * (0.5 + diffuse) + specular, 1.0), 1.0);\n"
+    "}\n";
+
+static const char *sphereVertexShaderSource =
+    "attribute vec4 vertex;\n"
+    "attribute vec4 instance;\n"
+    "attribute float label;\n"
+    "uniform sampler2D palette;\n"
+    "uniform vec2 paletteSize;\n"
+    "varying vec3 vertColor;\n"
+    "varying vec3 vertNormal;\n"
+    "uniform mat4 projMatrix;\n"
+    "uniform mat4 mvMatrix;\n"
+    "void main() {\n"
+    "   vertColor = (label < 0.0) ? vec3(1.0) : texture2DLod(palette, (vec2(mod(label, paletteSize.x), floor(label / paletteSize.x)) + 0.5) / paletteSize, 0.0).rgb;\n"
+    "   vertNormal = (mvMatrix * vec4(vertex.xyz, 0.0)).xyz;\n"
+    "   gl_Position = projMatrix * mvMatrix * vec4(instance.xyz + instance.w * vertex.xyz, 1.0);\n"
+    "}\n";
+
+static const char *sphereFragmentShaderSource =
+    "varying highp vec3 vertColor;\n"
+    "varying highp vec3 vertNormal;\n"
+    "void main() {\n"
+    "   highp vec3 normal = normalize(vertNormal);\n"
+    "   highp vec3 light = normalize(vec3(1.0, 1.0, 1.0));\n"
+    "   highp vec3 halfway = normalize(light + vec3(0.0, 0.0, 1.0));\n"
+    "   highp float diffuse = max(dot(normal, light), 0.0);\n"
+    "   highp float specular = (diffuse > 0.0) ? 0.5 * pow(max(dot(normal, halfway), 0.0), 50.0) : 0.0;\n"
+    "   gl_FragColor = vec4(min(vertColor * (0.5 + diffuse) + specular, 1.0), 1.0);\n"
+    "}\n";
+
+static const char *impostorVertexShaderSourceCore =
+    "#version 150\n"
+    "in vec2 vertex;\n"
+    "in vec4 instance;\n"
+    "in float label;\n"
+    "uniform sampler2D palette;\n"
+    "uniform vec2 paletteSize;\n"
+    "out vec3 vertColor;\n"
+    "out vec3 vertPosition;\n"
+    "out vec4 sphere;\n"
+    "uniform mat4 projMatrix;\n"
+    "uniform mat4 mvMatrix;\n"
+    "void main() {\n"
+    "   vec3 center = (mvMatrix * vec4(instance.xyz, 1.0)).xyz;\n"
+    "   float radius = instance.w;\n"
+    "   float distance = length(center);\n"
+    "   vec3 view = center / distance;\n"
+    "   vec3 right = normalize(cross(view, (abs(view.y) < 0.99) ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0)));\n"
+    "   vec3 up = cross(right, view);\n"
+    "   float size = (distance > 1.001 * radius) ? radius * distance / sqrt(distance * distance - radius * radius) : 1000.0 * radius;\n"
+    "   vertColor = (label < 0.0) ? vec3(1.0) : texelFetch(palette, ivec2(mod(label, paletteSize.x), floor(label / paletteSize.x)), 0).rgb;\n"
+    "   vertPosition = center + (vertex.x * right + vertex.y * up) * size;\n"
+    "   sphere = vec4(center, radius);\n"
+    "   gl_Position = projMatrix * vec4(vertPosition, 1.0);\n"
+    "}\n";
+
+static const char *impostorFragmentShaderSourceCore =
+    "#version 150\n"
+    "in vec3 vertColor;\n"
+    "in vec3 vertPosition;\n"
+    "in vec4 sphere;\n"
+    "out highp vec4 fragColor;\n"
+    "uniform mat4 projMatrix;\n"
+    "void main() {\n"
+    "   vec3 ray = normalize(vertPosition);\n"
+    "   float b = dot(ray, sphere.xyz);\n"
+    "   float discriminant = b * b - dot(sphere.xyz, sphere.xyz) + sphere.w * sphere.w;\n"
+    "   if (discriminant < 0.0)\n"
+    "       discard;\n"
+    "   float t = b - sqrt(discriminant);\n"
+    "   if (t < 0.0)\n"
+    "       t = b + sqrt(discriminant);\n"
+    "   vec3 hit = t * ray;\n"
+    "   vec4 clip = projMatrix * vec4(hit, 1.0);\n"
+    "   gl_FragDepth = 0.5 * clip.z / clip.w + 0.5;\n"
+    "   vec3 normal = (hit - sphere.xyz) / sphere.w;\n"
+    "   vec3 light = normalize(vec3(1.0, 1.0, 1.0));\n"
+    "   vec3 halfway = normalize(light + vec3(0.0, 0.0, 1.0));\n"
+    "   float diffuse = max(dot(normal, light), 0.0);\n"
+    "   float specular = (diffuse > 0.0) ? 0.5 * pow(max(dot(normal, halfway), 0.0), 50.0) : 0.0;\n"
+    "   fragColor = vec4(min(vertColor * (0.5 + diffuse) + specular, 1.0), 1.0);\n"
+    "}\n";
+
+static const char *impostorVertexShaderSource =
+    "attribute vec2 vertex;\n"
+    "attribute vec4 instance;\n"
+    "attribute float label;\n"
+    "uniform sampler2D palette;\n"
+    "uniform vec2 paletteSize;\n"
+    "varying vec3 vertColor;\n"
+    "varying vec3 vertPosition;\n"
+    "varying vec4 sphere;\n"
+    "uniform mat4 projMatrix;\n"
+    "uniform mat4 mvMatrix;\n"
+    "void main() {\n"
+    "   vec3 center = (mvMatrix * vec4(instance.xyz, 1.0)).xyz;\n"
+    "   float radius = instance.w;\n"
+    "   float distance = length(center);\n"
+    "   vec3 view = center / distance;\n"
+    "   vec3 right = normalize(cross(view, (abs(view.y) < 0.99) ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0)));\n"
+    "   vec3 up = cross(right, view);\n"
+    "   float size = (distance > 1.001 * radius) ? radius * distance / sqrt(distance * distance - radius * radius) : 1000.0 * radius;\n"
+    "   vertColor = (label < 0.0) ? vec3(1.0) : texture2DLod(palette, (vec2(mod(label, paletteSize.x), floor(label / paletteSize.x)) + 0.5) / paletteSize, 0.0).rgb;\n"
+    "   vertPosition = center + (vertex.x * right + vertex.y * up) * size;\n"
+    "   sphere = vec4(center, radius);\n"
+    "   gl_Position = projMatrix * vec4(vertPosition, 1.0);\n"
+    "}\n";
+
+static const char *impostorFragmentShaderSource =
+    "varying highp vec3 vertColor;\n"
+    "varying highp vec3 vertPosition;\n"
+    "varying highp vec4 sphere;\n"
+    "uniform highp mat4 projMatrix;\n"
+    "void main() {\n"
+    "   highp vec3 ray = normalize(vertPosition);\n"
+    "   highp float b = dot(ray, sphere.xyz);\n"
+    "   highp float discriminant = b * b - dot(sphere.xyz, sphere.xyz) + sphere.w * sphere.w;\n"
+    "   if (discriminant < 0.0)\n"
+    "       discard;\n"
+    "   highp float t = b - sqrt(discriminant);\n"
+    "   if (t < 0.0)\n"
+    "       t = b + sqrt(discriminant);\n"
+    "   highp vec3 hit = t * ray;\n"
+    "   highp vec4 clip = projMatrix * vec4(hit, 1.0);\n"
+    "   gl_FragDepth = 0.5 * clip.z / clip.w + 0.5;\n"
+    "   highp vec3 normal = (hit - sphere.xyz) / sphere.w;\n"
+    "   highp vec3 light = normalize(vec3(1.0, 1.0, 1.0));\n"
+    "   highp vec3 halfway = normalize(light + vec3(0.0, 0.0, 1.0));\n"
+    "   highp float diffuse = max(dot(normal, light), 0.0);\n"
+    "   highp float specular = (diffuse > 0.0) ? 0.5 * pow(max(dot(normal, halfway), 0.0), 50.0) : 0.0;\n"
+    "   gl_FragColor = vec4(min(vertColor * (0.5 + diffuse) + specular, 1.0), 1.0);\n"
+    "}\n";
+
+void SceneRenderer::initialize(QOpenGLContext* context)
+{
+    initializeOpenGLFunctions();
+    // glMultiDrawArrays is not part of OpenGL ES, tracks are drawn one by one there
+    if (!context->isOpenGLES()) {
+        m_gl21 = QOpenGLVersionFunctionsFactory::get<QOpenGLFunctions_2_1>(context);
+    }
+
+    // Alpha ramp used to fade the tails of the tracks
+    const int rampSize = 64;
+    GLubyte ramp[4 * rampSize];
+    for (int i = 0; i < rampSize; i++) {
+        ramp[4 * i] = ramp[4 * i + 1] = ramp[4 * i + 2] = 255;
+        ramp[4 * i + 3] = (255 * i) / (rampSize - 1);
+    }
+    glGenTextures(1, &tracksFadeTexture);
+    glBindTexture(GL_TEXTURE_1D, tracksFadeTexture);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexImage1D(GL_TEXTURE_1D, 0, GL_RGBA, rampSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, ramp);
+    glBindTexture(GL_TEXTURE_1D, 0);
+
+    // Faces are lit with the normal of the face and the light of the fixed pipeline (1, 1, 1)
+    snapshotProgram = new QOpenGLShaderProgram;
+    snapshotProgram->addShaderFromSourceCode(QOpenGLShader::Vertex, m_core ? snapshotVertexShaderSourceCore : snapshotVertexShaderSource);
+    snapshotProgram->addShaderFromSourceCode(QOpenGLShader::Fragment, m_core ? snapshotFragmentShaderSourceCore : snapshotFragmentShaderSource);
+    snapshotProgram->bindAttributeLocation("vertex", 0);
+    snapshotProgram->bindAttributeLocation("label", 1);
+    snapshotProgram->bindAttributeLocation("normal", 2);
+    if (!snapshotProgram->link()) {
+        cout << "SceneRenderer. Error at linking the snapshot shaders " << snapshotProgram->log().toStdString() << endl;
+        delete snapshotProgram;
+        snapshotProgram = nullptr;
+    }
+    else {
+        snapshotProjMatrixLoc = snapshotProgram->uniformLocation("projMatrix");
+        snapshotMvMatrixLoc = snapshotProgram->uniformLocation("mvMatrix");
+        snapshotLitLoc = snapshotProgram->uniformLocation("lit");
+    }
+    snapshotVao.create();
+
+    // Spheres are lit as the fixed pipeline does: ambient, diffuse and specular
+    sphereProgram = new QOpenGLShaderProgram;
+    sphereProgram->addShaderFromSourceCode(QOpenGLShader::Vertex, m_core ? sphereVertexShaderSourceCore : sphereVertexShaderSource);
+    sphereProgram->addShaderFromSourceCode(QOpenGLShader::Fragment, m_core ? sphereFragmentShaderSourceCore : sphereFragmentShaderSource);
+    sphereProgram->bindAttributeLocation("vertex", 0);
+    sphereProgram->bindAttributeLocation("instance", 1);
+    sphereProgram->bindAttributeLocation("label", 2);
+    if (!sphereProgram->link()) {
+        cout << "SceneRenderer. Error at linking the sphere shaders " << sphereProgram->log().toStdString() << endl;
+        delete sphereProgram;
+        sphereProgram = nullptr;
+    }
+    else {
+        sphereProjMatrixLoc = sphereProgram->uniformLocation("projMatrix");
+        sphereMvMatrixLoc = sphereProgram->uniformLocation("mvMatrix");
+    }
+    // The quad of an impostor faces the camera and encloses the silhouette of the sphere
+    impostorProgram = new QOpenGLShaderProgram;
+    impostorProgram->addShaderFromSourceCode(QOpenGLShader::Vertex, m_core ? impostorVertexShaderSourceCore : impostorVertexShaderSource);
+    impostorProgram->addShaderFromSourceCode(QOpenGLShader::Fragment, m_core ? impostorFragmentShaderSourceCore : impostorFragmentShaderSource);
+    impostorProgram->bindAttributeLocation("vertex", 0);
+    impostorProgram->bindAttributeLocation("instance", 1);
+    impostorProgram->bindAttributeLocation("label", 2);
+    if (!impostorProgram->link()) {
+        cout << "SceneRenderer. Error at linking the impostor shaders " << impostorProgram->log().toStdString() << endl;
+        delete impostorProgram;
+        impostorProgram = nullptr;
+    }
+    else {
+        impostorProjMatrixLoc = impostorProgram->uniformLocation("projMatrix");
+        impostorMvMatrixLoc = impostorProgram->uniformLocation("mvMatrix");
+    }
+    auto version = context->format().version();
+    if (version >= (context->isOpenGLES() ? qMakePair(3, 0) : qMakePair(3, 3))) {
+        m_extra = context->extraFunctions();
+    }
+    createSphereGeometry();
+
+    GLfloat mat_ambient[] = { 0.5, 0.5, 0.5, 1.0 };
+    GLfloat mat_specular[] = { 0.5, 0.5, 0.5, 1.0 };
+    GLfloat mat_shininess[] = { 50.0 };
+    GLfloat light_position[] = { 1.0, 1.0, 1.0, 0.0 };
+    GLfloat model_ambient[] = { 0.5, 0.5, 0.5, 1.0 };
+    glClearColor(0, 0, 0, 1);
+    glMaterialfv(GL_FRONT, GL_AMBIENT, mat_ambient);
+    glMaterialfv(GL_FRONT, GL_SPECULAR, mat_specular);
+    glMaterialfv(GL_FRONT, GL_SHININESS, mat_shininess);
+    glLightfv(GL_LIGHT0, GL_POSITION, light_position);
+    glLightModelfv(GL_LIGHT_MODEL_AMBIENT, model_ambient);
+}
+
+void SceneRenderer::paint(int time, const sceneCamera& camera)
+{
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+
+    QMatrix4x4 view;
+    view.translate(0.0, 0.0, -camera.distance);
+    view.rotate(camera.xRot, 1.0, 0.0, 0.0);
+    view.rotate(camera.yRot, 0.0, 1.0, 0.0);
+    if (scales.Type() == SpaceTime_t::ThreeDimension || scales.Type() == SpaceTime_t::ThreeDimensionAndTime) {
+        view.rotate(camera.zRot, 0.0, 0.0, 1.0);
+    }
+    float cameraX = boundaries.minX+(boundaries.maxX-boundaries.minX)/2;
+    float cameraY = boundaries.minY+(boundaries.maxY-boundaries.minY)/2;
+    float cameraZ = boundaries.maxZ/2;
+
+    view.translate(-cameraX, -cameraY, -cameraZ);
+    // Both matrices are column major as OpenGL expects them. Shaders take them as uniforms,
+    // the fixed function pipeline of a compatibility context draws the axes, grids and tracks
+    std::copy(view.constData(), view.constData() + 16, modelview);
+    if (!m_core) {
+        glEnable(GL_LIGHTING);
+        glEnable(GL_LIGHT0);
+        glEnable(GL_SMOOTH);
+        glEnable(GL_COLOR_MATERIAL);
+        glMatrixMode(GL_PROJECTION);
+        glLoadMatrixf(projection);
+        glMatrixMode(GL_MODELVIEW);
+        glLoadMatrixf(modelview);
+    }
+    painted = true;
+
+    drawSnapshot();
+
+    if (showAxes)
+        drawAxes();
+    if (showGrid2D)
+        drawGrid(grid2DBuffer, grid2DNumVertices);
+    if (showGrid3D)
+        drawGrid(grid3DBuffer, grid3DNumVertices);
+    if (showTracks && (tracks.NumTracks() > 0) ) {
+        drawTracks(time);
+    }
+    glFlush();
+}
+
+void SceneRenderer::resize(int width, int height, float pixelRatio)
+{
+    viewportHeight = std::max(1, static_cast<int>(height * pixelRatio));
+    glViewport(0, 0, width, height);
+    QMatrix4x4 perspective;
+    perspective.perspective(45.0, (GLfloat)width / (GLfloat)std::max(height, 1), 0.01f, 100000.0);
+    std::copy(perspective.constData(), perspective.constData() + 16, projection);
+}
+
+// Side of a gluCylinder along z (without caps) as triangles of x, y, z, normal, rgba vertices
+static void addCylinder(vector<float>& vertices, float base, float top, float z, float height, int slices, const float* color)
+{
+    // Smooth normals as gluCylinder: the side slope is given by the change of radius
+    float slope = (base - top) / height;
+    float scale = 1.0f / sqrt(1.0f + slope * slope);
+    auto vertex = [&](int slice, bool upper) {
+        float angle = 2.0f * M_PI * slice / slices;
+        float radius = upper ? top : base;
+        vertices.insert(vertices.end(), {radius * cos(angle), radius * sin(angle), upper ? z + height : z,
+                                         scale * cos(angle), scale * sin(angle), scale * slope});
+        vertices.insert(vertices.end(), color, color + 4);
+    };
+    for (int i = 0; i < slices; i++) {
+        vertex(i, false);
+        vertex(i + 1, false);
+        vertex(i + 1, true);
+        // Cones end in a point, the second triangle is empty
+        if (top > 0.0f) {
+            vertex(i, false);
+            vertex(i + 1, true);
+            vertex(i, true);
+        }
+    }
+}
+
+void SceneRenderer::uploadSceneFurniture()
+{
+    if (!axesBuffer.isCreated()) {
+        axesBuffer.create();
+        grid2DBuffer.create();
+        grid3DBuffer.create();
+    }
+
+    // Axes: a cylinder and a cone along z, rotated to x and y
+    const int slices = 15;
+    const int stride = 10;
+    float height = (boundaries.maxX - boundaries.minX)/2;
+    float radius = height / 50.0;
+    const float blue[4] = {0, 0, 1, 0.5};
+    const float red[4] = {1, 0, 0, 0.5};
+    const float green[4] = {0, 1, 0, 0.5};
+    vector<float> axes;
+    for (auto color: {blue, red, green}) {
+        size_t first = axes.size();
+        addCylinder(axes, radius, radius, 0.0, height, slices, color);
+        addCylinder(axes, radius*2.0, 0, height, height/10.0, slices, color);
+        for (size_t i = first; i < axes.size(); i += stride) {
+            for (int offset : {0, 3}) {
+                float* v = &axes[i + offset];
+                if (color == red) {
+                    // Rotation of 90 degrees around y
+                    float x = v[0];
+                    v[0] = v[2];
+                    v[2] = -x;
+                }
+                else if (color == green) {
+                    // Rotation of -90 degrees around x
+                    float y = v[1];
+                    v[1] = v[2];
+                    v[2] = -y;
+                }
+            }
+        }
+    }
+    axesNumVertices = axes.size() / stride;
+    axesBuffer.bind();
+    axesBuffer.allocate(axes.data(), axes.size() * sizeof(float));
+
+    // Grids: the xy plane for 2D, planes along z and x for 3D
+    pair xyAxis('x', 'y');
+    pair yzAxis('y', 'z');
+    vector<float> grid;
+    addPlaneGrid(grid, xyAxis, linesPerGrid, 0);
+    grid2DNumVertices = grid.size() / 3;
+    grid2DBuffer.bind();
+    grid2DBuffer.allocate(grid.data(), grid.size() * sizeof(float));
+    grid.clear();
+    if (scales.Type() == SpaceTime_t::ThreeDimension || scales.Type() == SpaceTime_t::ThreeDimensionAndTime)
+    {
+        for (int i = 0; i <= linesPerGrid; i++) {
+            addPlaneGrid(grid, xyAxis, linesPerGrid, i);
+            addPlaneGrid(grid, yzAxis, linesPerGrid, i);
+        }
+    }
+    grid3DNumVertices = grid.size() / 3;
+    grid3DBuffer.bind();
+    grid3DBuffer.allocate(grid.data(), grid.size() * sizeof(float));
+    grid3DBuffer.release();
+    furnitureUploaded = true;
+}
+
+void SceneRenderer::drawAxes()
+{
+    if (!furnitureUploaded) {
+        uploadSceneFurniture();
+    }
+    const int stride = 10 * sizeof(float);
+    axesBuffer.bind();
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    glVertexPointer(3, GL_FLOAT, stride, nullptr);
+    glNormalPointer(GL_FLOAT, stride, reinterpret_cast<const void*>(3 * sizeof(float)));
+    glColorPointer(4, GL_FLOAT, stride, reinterpret_cast<const void*>(6 * sizeof(float)));
+    glDrawArrays(GL_TRIANGLES, 0, axesNumVertices);
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    axesBuffer.release();
+}
+
+void SceneRenderer::addPlaneGrid(vector<float>& vertices, pair<char, char>axes, int numLines, float freeAxis)
+{
+    float spacing = pow(10.0, gridSpacing);
+    float length = numLines * spacing;
+    float plane = freeAxis * spacing;
+    if (axes.first == 'x' && axes.second == 'y')
+    {
+        for (int i = 0; i <= numLines; i++)
+        {
+            float val = i * spacing;
+            vertices.insert(vertices.end(), {val, 0.0, plane});
+            vertices.insert(vertices.end(), {val, length, plane});
+            vertices.insert(vertices.end(), {0.0, val, plane});
+            vertices.insert(vertices.end(), {length, val, plane});
+        }
+    }
+
+    if (axes.first == 'y' && axes.second == 'z')
+    {
+        for (int i = 0; i <= numLines; i++)
+        {
+            float val = i * spacing;
+            vertices.insert(vertices.end(), {plane, val, 0.0});
+            vertices.insert(vertices.end(), {plane, val, length});
+            vertices.insert(vertices.end(), {plane, 0.0, val});
+            vertices.insert(vertices.end(), {plane, length, val});
+        }
+    }
+}
+
+void SceneRenderer::drawGrid(QOpenGLBuffer& buffer, int numVertices)
+{
+    if (!furnitureUploaded) {
+        uploadSceneFurniture();
+    }
+    glColor3f(0.5, 0.5, 0.5);
+    buffer.bind();
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glVertexPointer(3, GL_FLOAT, 0, nullptr);
+    glDrawArrays(GL_LINES, 0, numVertices);
+    glDisableClientState(GL_VERTEX_ARRAY);
+    buffer.release();
+}
+
+int SceneRenderer::getGridSpacing(Boundaries box)
+{
+    for (int i = 0; i < 10; i++)
+    {
+        int positive = static_cast<int> (box.maxX - box.minX) / (pow(10.0, i));
+        if (positive > 0 && positive < 10)
+            return i;
+        int negative = static_cast<int> (box.maxX - box.minX) / (pow(10.0, -i));
+        if (negative > 0 && negative < 10)
+            return -i;
+    }
+    return 1;
+}
+
+void SceneRenderer::drawTracks(int t)
+{
+    // Every track is drawn with the coarsest level whose tolerance projects under one pixel.
+    // Pixels covered by a length of 1 at a distance of 1 from the camera (45 degrees field of view)
+    const float focal = viewportHeight / (2.0f * tan(M_PI / 8.0));
+
+    tracksJoints.clear();
+    auto addJoint = [&](size_t track, const BD5::TrackStore& store, int level, int point) {
+        int index = store.Offset(track) + point;
+        const float* color = &tracksColors[0][3 * tracks.Offset(track)];
+        tracksJoints.insert(tracksJoints.end(), store.Coordinates() + 3 * index, store.Coordinates() + 3 * index + 3);
+        tracksJoints.insert(tracksJoints.end(), color, color + 3);
+        tracksJoints.push_back(tracksTimes[level][index]);
+    };
+    for (size_t i = 0; i < tracks.NumTracks(); i++) {
+        int level = 0;
+        auto center = tracks.Center(i);
+        float distance = -(modelview[2] * center[0] + modelview[6] * center[1] + modelview[10] * center[2] + modelview[14]);
+        if (distance > 0.0f) {
+            float pixels = tracks.Extent(i) * focal / distance;
+            for (int lod = tracksLods.size(); lod > 0; lod--) {
+                if (tracksLodTolerances[lod - 1] * pixels <= 1.0f) {
+                    level = lod;
+                    break;
+                }
+            }
+        }
+        // Tracks are sorted by time, the visible part of a track is a window of its points:
+        // the full history until t or the tail of the last tracksTail times
+        auto& store = (level == 0) ? tracks : tracksLods[level - 1];
+        int first = (tracksTail > 0) ? store.FirstAtTime(i, t - tracksTail) : 0;
+        tracksLevel[i] = level;
+        tracksFirst[i] = tracksLevelBase[level] + store.Offset(i) + first;
+        tracksCount[i] = store.CountAtTime(i, t) - first;
+
+        // Coarse levels drop points, so their window can start after the true first point and
+        // end before the true position at t. Both are joined with the full resolution points
+        if (level > 0) {
+            int fullFirst = (tracksTail > 0) ? tracks.FirstAtTime(i, t - tracksTail) : 0;
+            int fullLast = tracks.CountAtTime(i, t) - 1;
+            if (fullLast < fullFirst) {
+                continue;
+            }
+            if (tracksCount[i] <= 0) {
+                addJoint(i, tracks, 0, fullFirst);
+                addJoint(i, tracks, 0, fullLast);
+                continue;
+            }
+            int last = first + tracksCount[i] - 1;
+            if (store.Times()[store.Offset(i) + first] != tracks.Times()[tracks.Offset(i) + fullFirst]) {
+                addJoint(i, tracks, 0, fullFirst);
+                addJoint(i, store, level, first);
+            }
+            if (store.Times()[store.Offset(i) + last] != tracks.Times()[tracks.Offset(i) + fullLast]) {
+                addJoint(i, store, level, last);
+                addJoint(i, tracks, 0, fullLast);
+            }
+        }
+    }
+
+    // The time of every point is the coordinate of an alpha ramp. The texture matrix
+    // maps the tail [t - tracksTail, t] to [0, 1]
+    bool fading = tracksFading && (tracksTail > 0);
+    if (fading) {
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glEnable(GL_TEXTURE_1D);
+        glBindTexture(GL_TEXTURE_1D, tracksFadeTexture);
+        glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+        glMatrixMode(GL_TEXTURE);
+        glLoadIdentity();
+        glScalef(1.0f / tracksTail, 1.0f, 1.0f);
+        glTranslatef(-(t - tracksTail), 0.0f, 0.0f);
+        glMatrixMode(GL_MODELVIEW);
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    }
+
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_COLOR_ARRAY);
+    if (m_gl21 != nullptr) {
+        if (!tracksUploaded) {
+            uploadTracks();
+        }
+        tracksVertexBuffer.bind();
+        glVertexPointer(3, GL_FLOAT, 0, nullptr);
+        tracksColorBuffer.bind();
+        glColorPointer(3, GL_FLOAT, 0, nullptr);
+        tracksTimeBuffer.bind();
+        glTexCoordPointer(1, GL_FLOAT, 0, nullptr);
+        tracksTimeBuffer.release();
+        m_gl21->glMultiDrawArrays(GL_LINE_STRIP, tracksFirst.data(), tracksCount.data(), tracksFirst.size());
+    }
+    else {
+        for (size_t level = 0; level < tracksLevelBase.size(); level++) {
+            auto& store = (level == 0) ? tracks : tracksLods[level - 1];
+            glVertexPointer(3, GL_FLOAT, 0, store.Coordinates());
+            glColorPointer(3, GL_FLOAT, 0, tracksColors[level].data());
+            glTexCoordPointer(1, GL_FLOAT, 0, tracksTimes[level].data());
+            for (size_t i = 0; i < tracksFirst.size(); i++) {
+                if ( (tracksLevel[i] == static_cast<int>(level)) && (tracksCount[i] > 0) ) {
+                    glDrawArrays(GL_LINE_STRIP, tracksFirst[i] - tracksLevelBase[level], tracksCount[i]);
+                }
+            }
+        }
+    }
+    if (!tracksJoints.empty()) {
+        const int stride = 7 * sizeof(float);
+        glVertexPointer(3, GL_FLOAT, stride, tracksJoints.data());
+        glColorPointer(3, GL_FLOAT, stride, tracksJoints.data() + 3);
+        glTexCoordPointer(1, GL_FLOAT, stride, tracksJoints.data() + 6);
+        glDrawArrays(GL_LINES, 0, tracksJoints.size() / 7);
+    }
+    glDisableClientState(GL_COLOR_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+
+    if (fading) {
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+        glMatrixMode(GL_TEXTURE);
+        glLoadIdentity();
+        glMatrixMode(GL_MODELVIEW);
+        glBindTexture(GL_TEXTURE_1D, 0);
+        glDisable(GL_TEXTURE_1D);
+        glDisable(GL_BLEND);
+    }
+}
+
+void SceneRenderer::setTracks(BD5::TrackStore store, vector<BD5::TrackStore> lods)
+{
+    tracks = std::move(store);
+    tracksLods = std::move(lods);
+    tracksColors.clear();
+    tracksTimes.clear();
+    tracksLevelBase.clear();
+
+    // Every track keeps its palette color along the time and in all the levels
+    ColorPalette palette;
+    int base = 0;
+    for (size_t level = 0; level <= tracksLods.size(); level++) {
+        auto& levelStore = (level == 0) ? tracks : tracksLods[level - 1];
+        vector<float> colors;
+        colors.reserve(3 * levelStore.NumPoints());
+        for (size_t i = 0; i < levelStore.NumTracks(); i++) {
+            auto color = palette.GetColorAt(i);
+            for (int j = 0; j < levelStore.Count(i); j++) {
+                colors.insert(colors.end(), color.begin(), color.begin() + 3);
+            }
+        }
+        tracksColors.push_back(std::move(colors));
+        tracksTimes.push_back(vector<float>(levelStore.Times(), levelStore.Times() + levelStore.NumPoints()));
+        tracksLevelBase.push_back(base);
+        base += levelStore.NumPoints();
+    }
+
+    tracksLevel.assign(tracks.NumTracks(), 0);
+    tracksFirst.assign(tracks.NumTracks(), 0);
+    tracksCount.assign(tracks.NumTracks(), 0);
+    tracksUploaded = false;
+}
+
+void SceneRenderer::uploadTracks()
+{
+    if (!tracksVertexBuffer.isCreated()) {
+        tracksVertexBuffer.create();
+        tracksColorBuffer.create();
+        tracksTimeBuffer.create();
+    }
+    // All the levels one after the other
+    int numPoints = tracksLevelBase.back() + ((tracksLods.empty()) ? tracks.NumPoints() : tracksLods.back().NumPoints());
+    tracksVertexBuffer.bind();
+    tracksVertexBuffer.allocate(3 * numPoints * sizeof(float));
+    tracksColorBuffer.bind();
+    tracksColorBuffer.allocate(3 * numPoints * sizeof(float));
+    tracksTimeBuffer.bind();
+    tracksTimeBuffer.allocate(numPoints * sizeof(float));
+    for (size_t level = 0; level < tracksLevelBase.size(); level++) {
+        auto& store = (level == 0) ? tracks : tracksLods[level - 1];
+        int offset = 3 * tracksLevelBase[level] * sizeof(float);
+        int size = 3 * store.NumPoints() * sizeof(float);
+        tracksVertexBuffer.bind();
+        tracksVertexBuffer.write(offset, store.Coordinates(), size);
+        tracksColorBuffer.bind();
+        tracksColorBuffer.write(offset, tracksColors[level].data(), size);
+        tracksTimeBuffer.bind();
+        tracksTimeBuffer.write(offset / 3, tracksTimes[level].data(), size / 3);
+    }
+    tracksTimeBuffer.release();
+    tracksUploaded = true;
+}
+
+void SceneRenderer::drawSnapshot()
+{
+    if ( (snapshotMesh.NumVertices() == 0) && (snapshotMesh.NumInstances() == 0) ) {
+        return;
+    }
+    if (indexReady) {
+        index.VisibleBatches(BD5::Frustum(projection, modelview), visibleBatches);
+    }
+
+    QOpenGLVertexArrayObject::Binder vaoBinder(&snapshotVao);
+    if (!snapshotUploaded) {
+        uploadSnapshot();
+    }
+    if (!paletteUploaded) {
+        uploadPalette();
+    }
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, paletteTexture);
+    if (snapshotProgram == nullptr) {
+        drawSpheres(projection, modelview);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return;
+    }
+    snapshotProgram->bind();
+    glUniformMatrix4fv(snapshotProjMatrixLoc, 1, GL_FALSE, projection);
+    glUniformMatrix4fv(snapshotMvMatrixLoc, 1, GL_FALSE, modelview);
+    bindPalette(snapshotProgram);
+    snapshotVertexBuffer.bind();
+    snapshotProgram->enableAttributeArray(0);
+    snapshotProgram->setAttributeBuffer(0, GL_FLOAT, 0, 3);
+    // Label ids are converted to float, not normalized
+    snapshotLabelBuffer.bind();
+    snapshotProgram->enableAttributeArray(1);
+    glVertexAttribPointer(1, 1, GL_INT, GL_FALSE, 0, nullptr);
+    snapshotLabelBuffer.release();
+    snapshotNormalBuffer.bind();
+    snapshotProgram->enableAttributeArray(2);
+    snapshotProgram->setAttributeBuffer(2, GL_BYTE, 0, 3, 4);
+    snapshotNormalBuffer.release();
+    snapshotIndexBuffer.bind();
+
+    // Only the batches inside the view frustum are drawn, with one call per subobject
+    BD5::Frustum frustum(projection, modelview);
+    for (auto& range : snapshotMesh.Ranges())
+    {
+        if ( (range.type == EntityType::Sphere) || !isObjectVisible(range.object) ) {
+            continue;
+        }
+        cullRange(range, frustum);
+        if (visibleFirst.empty()) {
+            continue;
+        }
+        snapshotProgram->setUniformValue(snapshotLitLoc, range.type == EntityType::Face);
+        if (range.type == EntityType::Point) {
+            glPointSize(pointSize);
+            if (m_gl21 != nullptr) {
+                m_gl21->glMultiDrawArrays(GL_POINTS, visibleFirst.data(), visibleCount.data(), visibleFirst.size());
+            }
+            else {
+                for (size_t i = 0; i < visibleFirst.size(); i++) {
+                    glDrawArrays(GL_POINTS, visibleFirst[i], visibleCount[i]);
+                }
+            }
+            continue;
+        }
+        GLenum mode = (range.type == EntityType::Line) ? GL_LINES : GL_TRIANGLES;
+        visibleIndices.clear();
+        for (auto first : visibleFirst) {
+            visibleIndices.push_back(reinterpret_cast<const void*>(first * sizeof(uint32_t)));
+        }
+        if (m_gl21 != nullptr) {
+            m_gl21->glMultiDrawElements(mode, visibleCount.data(), GL_UNSIGNED_INT, visibleIndices.data(), visibleIndices.size());
+        }
+        else {
+            for (size_t i = 0; i < visibleIndices.size(); i++) {
+                glDrawElements(mode, visibleCount[i], GL_UNSIGNED_INT, visibleIndices[i]);
+            }
+        }
+    }
+
+    snapshotIndexBuffer.release();
+    snapshotProgram->disableAttributeArray(0);
+    snapshotProgram->disableAttributeArray(1);
+    snapshotProgram->disableAttributeArray(2);
+    snapshotProgram->release();
+
+    drawSpheres(projection, modelview);
+    glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+void SceneRenderer::cullRange(const BD5::MeshRange& range, const BD5::Frustum& frustum)
+{
+    // The spatial index already gave the visible batches of this frame, until it is built 
+    // every subobject is culled by its own batches
+    if (indexReady) {
+        snapshotMesh.Runs(range, visibleBatches, visibleFirst, visibleCount);
+    }
+    else {
+        snapshotMesh.Cull(range, frustum, visibleFirst, visibleCount);
+    }
+}
+
+void SceneRenderer::drawSpheres(const GLfloat* projection, const GLfloat* modelview)
+{
+    if (snapshotMesh.NumInstances() == 0) {
+        return;
+    }
+    // Visible chunks of spheres of all the subobjects
+    BD5::Frustum frustum(projection, modelview);
+    spheresFirst.clear();
+    spheresCount.clear();
+    int numInstances = 0;
+    for (auto& range : snapshotMesh.Ranges())
+    {
+        if ( (range.numInstances == 0) || !isObjectVisible(range.object) ) {
+            continue;
+        }
+        cullRange(range, frustum);
+        spheresFirst.insert(spheresFirst.end(), visibleFirst.begin(), visibleFirst.end());
+        spheresCount.insert(spheresCount.end(), visibleCount.begin(), visibleCount.end());
+        for (auto count : visibleCount) {
+            numInstances += count;
+        }
+    }
+    if (numInstances == 0) {
+        return;
+    }
+    // With many spheres the vertices of the meshes limit the frame rate
+    bool impostors = (m_extra != nullptr) && (impostorProgram != nullptr) && 
+        ( (sphereMode == SphereMode::Impostors) || 
+          ((sphereMode == SphereMode::Automatic) && (numInstances > impostorsThreshold)) );
+    QOpenGLShaderProgram *program = impostors ? impostorProgram : sphereProgram;
+    if (program == nullptr) {
+        return;
+    }
+    program->bind();
+    glUniformMatrix4fv(impostors ? impostorProjMatrixLoc : sphereProjMatrixLoc, 1, GL_FALSE, projection);
+    glUniformMatrix4fv(impostors ? impostorMvMatrixLoc : sphereMvMatrixLoc, 1, GL_FALSE, modelview);
+    bindPalette(program);
+    if (impostors) {
+        impostorVertexBuffer.bind();
+        program->enableAttributeArray(0);
+        program->setAttributeBuffer(0, GL_FLOAT, 0, 2);
+        impostorVertexBuffer.release();
+        // Quads are not oriented
+        glDisable(GL_CULL_FACE);
+    }
+    else {
+        sphereVertexBuffer.bind();
+        program->enableAttributeArray(0);
+        program->setAttributeBuffer(0, GL_FLOAT, 0, 3);
+        sphereVertexBuffer.release();
+        sphereIndexBuffer.bind();
+    }
+
+    auto& instances = snapshotMesh.Instances();
+    auto& labelIds = snapshotMesh.InstanceLabelIds();
+    for (size_t run = 0; run < spheresFirst.size(); run++)
+    {
+        int first = spheresFirst[run];
+        int count = spheresCount[run];
+        if (m_extra != nullptr) {
+            // Center, radius and label advance once per instance
+            spheresInstanceBuffer.bind();
+            program->enableAttributeArray(1);
+            program->setAttributeBuffer(1, GL_FLOAT, 4 * first * sizeof(float), 4);
+            m_extra->glVertexAttribDivisor(1, 1);
+            spheresLabelBuffer.bind();
+            program->enableAttributeArray(2);
+            glVertexAttribPointer(2, 1, GL_INT, GL_FALSE, 0, reinterpret_cast<const void*>(first * sizeof(int)));
+            m_extra->glVertexAttribDivisor(2, 1);
+            spheresLabelBuffer.release();
+            if (impostors) {
+                m_extra->glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+            }
+            else {
+                m_extra->glDrawElementsInstanced(GL_TRIANGLES, sphereNumIndices, GL_UNSIGNED_INT, nullptr, count);
+            }
+            m_extra->glVertexAttribDivisor(1, 0);
+            m_extra->glVertexAttribDivisor(2, 0);
+            program->disableAttributeArray(1);
+            program->disableAttributeArray(2);
+        }
+        else {
+            // Without instancing the attributes are constant for every sphere
+            for (int i = first; i < first + count; i++) {
+                glVertexAttrib4fv(1, &instances[4 * i]);
+                glVertexAttrib1f(2, labelIds[i]);
+                glDrawElements(GL_TRIANGLES, sphereNumIndices, GL_UNSIGNED_INT, nullptr);
+            }
+        }
+    }
+
+    if (impostors) {
+        glEnable(GL_CULL_FACE);
+    }
+    else {
+        sphereIndexBuffer.release();
+    }
+    program->disableAttributeArray(0);
+    program->release();
+}
+
+void SceneRenderer::createSphereGeometry()
+{
+    // Vertices of the unit sphere are also its normals. Triangles are counterclockwise seen from outside
+    vector<float> vertices;
+    for (int i = 0; i <= sphereStacks; i++) {
+        float phi = M_PI * i / sphereStacks;
+        for (int j = 0; j <= sphereSlices; j++) {
+            float theta = 2.0 * M_PI * j / sphereSlices;
+            vertices.insert(vertices.end(), {sinf(phi) * cosf(theta), sinf(phi) * sinf(theta), cosf(phi)});
+        }
+    }
+    vector<GLuint> indices;
+    for (int i = 0; i < sphereStacks; i++) {
+        for (int j = 0; j < sphereSlices; j++) {
+            GLuint first = i * (sphereSlices + 1) + j;
+            GLuint below = first + sphereSlices + 1;
+            indices.insert(indices.end(), {first, below, first + 1, first + 1, below, below + 1});
+        }
+    }
+    sphereNumIndices = indices.size();
+
+    QOpenGLVertexArrayObject::Binder vaoBinder(&snapshotVao);
+    sphereVertexBuffer.create();
+    sphereVertexBuffer.bind();
+    sphereVertexBuffer.allocate(vertices.data(), vertices.size() * sizeof(float));
+    sphereVertexBuffer.release();
+    sphereIndexBuffer.create();
+    sphereIndexBuffer.bind();
+    sphereIndexBuffer.allocate(indices.data(), indices.size() * sizeof(GLuint));
+    sphereIndexBuffer.release();
+
+    // Corners of the impostor quad as a triangle strip
+    const GLfloat corners[] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+    impostorVertexBuffer.create();
+    impostorVertexBuffer.bind();
+    impostorVertexBuffer.allocate(corners, sizeof(corners));
+    impostorVertexBuffer.release();
+}
+
+void SceneRenderer::uploadSnapshot()
+{
+    if (!snapshotVertexBuffer.isCreated()) {
+        snapshotVertexBuffer.create();
+        snapshotLabelBuffer.create();
+        snapshotNormalBuffer.create();
+        snapshotIndexBuffer.create();
+        spheresInstanceBuffer.create();
+        spheresLabelBuffer.create();
+    }
+    auto& positions = snapshotMesh.Positions();
+    snapshotVertexBuffer.bind();
+    snapshotVertexBuffer.allocate(positions.data(), positions.size() * sizeof(float));
+    snapshotVertexBuffer.release();
+    auto& labelIds = snapshotMesh.LabelIds();
+    snapshotLabelBuffer.bind();
+    snapshotLabelBuffer.allocate(labelIds.data(), labelIds.size() * sizeof(int));
+    snapshotLabelBuffer.release();
+    auto& normals = snapshotMesh.Normals();
+    snapshotNormalBuffer.bind();
+    snapshotNormalBuffer.allocate(normals.data(), normals.size());
+    snapshotNormalBuffer.release();
+    auto& indices = snapshotMesh.Indices();
+    snapshotIndexBuffer.bind();
+    snapshotIndexBuffer.allocate(indices.data(), indices.size() * sizeof(uint32_t));
+    snapshotIndexBuffer.release();
+    auto& instances = snapshotMesh.Instances();
+    spheresInstanceBuffer.bind();
+    spheresInstanceBuffer.allocate(instances.data(), instances.size() * sizeof(float));
+    spheresInstanceBuffer.release();
+    auto& instanceLabelIds = snapshotMesh.InstanceLabelIds();
+    spheresLabelBuffer.bind();
+    spheresLabelBuffer.allocate(instanceLabelIds.data(), instanceLabelIds.size() * sizeof(int));
+    spheresLabelBuffer.release();
+    snapshotUploaded = true;
+}
+
+scenePalette SceneRenderer::buildPalette(const vector<map<string, vector<float>>>& labelsColors, const BD5::LabelDictionary& dictionary)
+{
+    scenePalette palette;
+    palette.height = std::max(1, (dictionary.Size() + paletteWidth - 1) / paletteWidth);
+    palette.texels.assign(4 * paletteWidth * palette.height, 255);
+    for (auto& obj: labelsColors)
+    {
+        for (auto& [label, color]: obj)
+        {
+            int id = dictionary.Find(label);
+            if ( (id < 0) || (color.size() < 3) ) {
+                continue;
+            }
+            for (int c = 0; c < 3; c++) {
+                palette.texels[4 * id + c] = static_cast<GLubyte>(255.0f * std::clamp(color[c], 0.0f, 1.0f) + 0.5f);
+            }
+        }
+    }
+    return palette;
+}
+
+void SceneRenderer::uploadPalette()
+{
+    if (palette.texels.empty()) {
+        palette.height = 1;
+        palette.texels.assign(4 * paletteWidth, 255);
+    }
+    if (paletteTexture == 0) {
+        glGenTextures(1, &paletteTexture);
+    }
+    glBindTexture(GL_TEXTURE_2D, paletteTexture);
+    if (palette.height != paletteHeight) {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, paletteWidth, palette.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, palette.texels.data());
+        paletteHeight = palette.height;
+    }
+    else {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, paletteWidth, palette.height, GL_RGBA, GL_UNSIGNED_BYTE, palette.texels.data());
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    paletteUploaded = true;
+}
+
+void SceneRenderer::bindPalette(QOpenGLShaderProgram *program)
+{
+    program->setUniformValue("palette", 0);
+    program->setUniformValue("paletteSize", static_cast<GLfloat>(paletteWidth), static_cast<GLfloat>(paletteHeight));
+}
+
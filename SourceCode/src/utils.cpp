@@ -27,3 +27,19 @@ std::vector<float> ColorPalette::GetColorAt(int index) {
     i = (sIndex >= palette.size()) ? (sIndex % palette.size()) : sIndex;
     return palette.at(i);
 }
+
+std::vector<std::map<std::string, std::vector<float>>> ColorPalette::GetLabelsColors(const std::vector<std::vector<std::string>>& objLabels) {
+    std::vector<std::map<std::string, std::vector<float>>> colors;
+    int i = 0;
+    for (auto &obj: objLabels)
+    {
+        std::map<std::string, std::vector<float>> objLabelsColors;
+        for (auto &label : obj)
+        {
+            objLabelsColors[label] = GetColorAt(i);
+            i++;
+        }
+        colors.push_back(objLabelsColors);
+    }
+    return colors;
+}
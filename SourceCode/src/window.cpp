@@ -46,6 +46,11 @@ Window::Window(MainWindow *mw)
     connect(mw, &MainWindow::grid2DChanged, glWidget, &GLWidget::setGrid2DFlag);
     connect(mw, &MainWindow::grid3DChanged, glWidget, &GLWidget::setGrid3DFlag);
     connect(mw, &MainWindow::tracksChanged, glWidget, &GLWidget::setTracksFlag);
+    connect(mw, &MainWindow::tracksTailChanged, glWidget, &GLWidget::setTracksTail);
+    connect(mw, &MainWindow::tracksFadingChanged, glWidget, &GLWidget::setTracksFading);
+    connect(mw, &MainWindow::sphereModeChanged, glWidget, &GLWidget::setSphereMode);
+    connect(mw, &MainWindow::impostorsThresholdChanged, glWidget, &GLWidget::setImpostorsThreshold);
+    connect(mw, &MainWindow::quantizedStorageChanged, glWidget, &GLWidget::setQuantizedStorage);
     connect(this, &Window::showObjectCheckChanged, glWidget, &GLWidget::setObjectShowFlag);
     connect(this, &Window::labelColorChanged, glWidget, &GLWidget::setLabelColor);
     connect(this, &Window::labelsOneColorChanged, glWidget, &GLWidget::setLabelsOneColor);
@@ -58,6 +63,8 @@ Window::Window(MainWindow *mw)
     connect(glWidget, &GLWidget::moveToPrevTime, this, &Window::moveToPrevTime);
     connect(glWidget, &GLWidget::objectsNames, this, &Window::setObjectsNames);
     connect(glWidget, &GLWidget::labelsNames, this, &Window::setLabelsNames);
+    connect(glWidget, &GLWidget::tracksReady, mw, &MainWindow::setTracksEnabled);
+    connect(glWidget, &GLWidget::entityPicked, this, &Window::setPickedEntity);
 
     QString oneColorName = QString("Labels &colors");
     QGroupBox *oneColorGroupBox(new QGroupBox(oneColorName));
@@ -82,6 +89,18 @@ Window::Window(MainWindow *mw)
     scroll->setWidget(labelsGroupBox);
     scroll->setWidgetResizable(true);
     objsAndLabels->addWidget(scroll);
+
+    QGroupBox *pickedGroupBox(new QGroupBox(QString("Selection")));
+    pickedGroupBox->setFlat(true);
+    // As wide as the labels panel above it
+    pickedGroupBox->setMaximumWidth(scroll->maximumWidth());
+    pickedLabel = new QLabel(pickedGroupBox);
+    pickedLabel->setWordWrap(true);
+    pickedLabel->setTextInteractionFlags(Qt::TextSelectableByMouse);
+    setPickedEntity(QString());
+    QVBoxLayout *pickedLayout(new QVBoxLayout(pickedGroupBox));
+    pickedLayout->addWidget(pickedLabel);
+    objsAndLabels->addWidget(pickedGroupBox);
     objsAndLabels->setSizeConstraint(QLayout::SetMinimumSize);
 
     QGridLayout *mainLayout(new QGridLayout);
@@ -117,6 +136,11 @@ void Window::setCurrentTime(int time)
     indexTLabel->setText(text);
 }
 
+void Window::setPickedEntity(QString description)
+{
+    pickedLabel->setText(description.isEmpty() ? QString("Click an entity to see its data") : description);
+}
+
 void Window::keyPressEvent(QKeyEvent *e)
 {
     if (e->key() == Qt::Key_Escape)
@@ -125,11 +149,13 @@ void Window::keyPressEvent(QKeyEvent *e)
         QWidget::keyPressEvent(e);
 }
 
-void Window::createObjsGroupBox(vector<string> names) 
+void Window::createObjsGroupBox(vector<string> names, vector<bool> visibility) 
 {
-    for (auto& name: names) {
+    for (size_t i = 0; i < names.size(); i++) {
+        auto& name = names[i];
         QGroupBox *objectsGroup = new QGroupBox(QString(name.data()));
         objectsGroup->setCheckable(true);
+        objectsGroup->setChecked( (i < visibility.size()) ? visibility[i] : true );
         connect(objectsGroup, &QGroupBox::clicked, this, [name, this](bool flag)
         {
             emit showObjectCheckChanged(name, flag);
@@ -406,10 +432,10 @@ void Window::moveToPrevTime()
     }
 }
 
-void Window::setObjectsNames(vector<string> names)
+void Window::setObjectsNames(vector<string> names, vector<bool> visibility)
 {
     removeObjectsNames();
-    createObjsGroupBox(names);
+    createObjsGroupBox(names, visibility);
 }
 
 void Window::setLabelsNames(vector<string> objects, vector<vector<string>> names) 